@@ -0,0 +1,170 @@
+/** times the Piefile engine on generated Piefiles of 1k, 100k and 1M targets
+    in a few typical shapes, and prints the results as JSON (one object per
+    shape and size) so runs can be compared over time:
+
+    make bench && ./bench/piefile_bench [-j N] [shape or size]...
+
+    e.g. ./bench/piefile_bench chain 100000 > chain.json
+
+    shapes:
+    fanin    one "all" target that depends on every other target
+    chain    every target depends on the one before it
+    diamond  layers of sqrt(N) targets, each depending on two neighbours in
+             the layer above (a mesh of diamonds)
+    random   every target depends on 4 random earlier targets
+
+    Every target also depends on a source file and has one task. What's timed
+    is what pie --make does before and around running tasks:
+
+    read      map the Piefile into memory (MappedFile)
+    parse     parseTargets
+    graph     BuildGraph (interning + CSR)
+    sort      the Kahn sort of sortTargets
+    schedule  the Executor, with tasks that do nothing */
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/core/executor.hpp"
+#include "../src/core/graph.hpp"
+#include "../src/core/mapped.hpp"
+#include "../src/core/parser.hpp"
+
+using namespace std;
+using namespace std::chrono;
+
+static const char* SHAPES[] = { "fanin", "chain", "diamond", "random" };
+
+static string name(size_t i)
+{
+    return "t" + to_string(i);
+}
+
+/** the Piefile text of "count" targets in the given shape */
+static string generate(const string& shape, size_t count)
+{
+    string text, root;
+    mt19937 rng(42);
+    size_t width = max<size_t>(1, sqrt(count));
+    size_t leaves = shape == "fanin" ? count - 1 : count;
+
+    for (size_t i = 0; i < leaves; ++i) {
+        text += name(i) + ": src/" + name(i) + ".cpp";
+        if (shape == "chain" && i) {
+            text += " " + name(i - 1);
+        } else if (shape == "diamond" && i >= width) {
+            size_t above = i - width, layer = above - above % width;
+            text += " " + name(above) + " " + name(layer + (above + 1) % width);
+        } else if (shape == "random" && i) {
+            for (int j = 0; j < 4; ++j)
+                text += " " + name(rng() % i);
+        }
+        text += "\n\tg++ -c src/" + name(i) + ".cpp -o " + name(i) + "\n";
+        if (shape == "fanin")
+            root += " " + name(i);
+    }
+
+    if (shape == "fanin")
+        text += "all:" + root + "\n\tg++ -o all" + root + "\n";
+    return text;
+}
+
+static double ms(steady_clock::time_point from, steady_clock::time_point to)
+{
+    return duration<double, milli>(to - from).count();
+}
+
+/** one shape and size, printed as a JSON object; false if anything failed */
+static bool run(const string& shape, size_t count, unsigned int jobs, bool first)
+{
+    filesystem::path path = filesystem::temp_directory_path()
+                          / ("pie-bench-" + shape + "-" + to_string(count));
+    {
+        string text = generate(shape, count);
+        ofstream out(path, ios::binary | ios::trunc);
+        out.write(text.data(), text.size());
+    }
+
+    auto start = steady_clock::now();
+    MappedFile file;
+    bool ok = file.open(path.string());
+    auto read = steady_clock::now();
+
+    TargetMap nodes;
+    Variables vars;
+    ParseError error;
+    ok = ok && parseTargets(file.view(), nodes, vars, error);
+    auto parsed = steady_clock::now();
+
+    BuildGraph graph(nodes);
+    auto built = steady_clock::now();
+
+    vector<BuildGraph::Id> order, cycle;
+    ok = ok && graph.sort({}, order, cycle) && order.size() == count;
+    auto sorted = steady_clock::now();
+
+    Executor executor(graph, jobs);
+    ok = ok && executor.run(order, [](Target&, unsigned int) { return true; });
+    auto scheduled = steady_clock::now();
+
+    size_t edges = 0;
+    for (BuildGraph::Id id = 0; id < graph.size(); ++id)
+        edges += graph.deps(id).size();
+
+    printf("%s\n  {\"shape\": \"%s\", \"targets\": %zu, \"nodes\": %zu, "
+           "\"edges\": %zu, \"bytes\": %zu, \"jobs\": %u, \"ok\": %s,\n"
+           "   \"read_ms\": %.3f, \"parse_ms\": %.3f, \"graph_ms\": %.3f, "
+           "\"sort_ms\": %.3f, \"schedule_ms\": %.3f}",
+           first ? "" : ",", shape.c_str(), count, graph.size(), edges,
+           file.size(), jobs, ok ? "true" : "false", ms(start, read),
+           ms(read, parsed), ms(parsed, built), ms(built, sorted),
+           ms(sorted, scheduled));
+    fflush(stdout);
+
+    file.close();
+    filesystem::remove(path);
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    vector<string> shapes;
+    vector<size_t> sizes;
+    unsigned int jobs = 1;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc)
+            jobs = max(1, atoi(argv[++i]));
+        else if (isdigit((unsigned char)arg[0]))
+            sizes.push_back(max(2L, atol(arg.c_str())));
+        else if (find(begin(SHAPES), end(SHAPES), arg) != end(SHAPES))
+            shapes.push_back(arg);
+        else {
+            fprintf(stderr, "unknown shape [%s]\n", arg.c_str());
+            return 2;
+        }
+    }
+    if (shapes.empty())
+        shapes.assign(begin(SHAPES), end(SHAPES));
+    if (sizes.empty())
+        sizes = { 1000, 100000, 1000000 };
+
+    bool ok = true, first = true;
+    printf("{\"benchmarks\": [");
+    for (size_t count : sizes) {
+        for (const string& shape : shapes) {
+            ok = run(shape, count, jobs, first) && ok;
+            first = false;
+        }
+    }
+    printf("\n]}\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,56 @@
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+#include "buildlog.hpp"
+
+using namespace std;
+
+BuildLog::BuildLog(const string& path): path(path) { }
+
+bool BuildLog::load()
+{
+    ifstream file(path);
+    if (!file)
+        return false;
+
+    string line;
+    while (getline(file, line)) {
+        string::size_type tab = line.find('\t');
+        if (tab == string::npos || !tab)
+            continue;
+        try {
+            durations[line.substr(tab + 1)] = stoll(line.substr(0, tab));
+        } catch (...) {
+            /** a broken line only loses that one entry */
+        }
+    }
+    return true;
+}
+
+bool BuildLog::save()
+{
+    error_code ec;
+    filesystem::path file(path);
+    if (file.has_parent_path())
+        filesystem::create_directories(file.parent_path(), ec);
+
+    lock_guard<mutex> guard(lock);
+    ofstream out(path, ios::trunc);
+    for (auto& p : durations)
+        out << p.second << '\t' << p.first << '\n';
+    return bool(out);
+}
+
+int64_t BuildLog::duration(const string& name)
+{
+    lock_guard<mutex> guard(lock);
+    auto it = durations.find(name);
+    return it == durations.end() ? -1 : it->second;
+}
+
+void BuildLog::record(const string& name, int64_t ms)
+{
+    lock_guard<mutex> guard(lock);
+    durations[name] = ms;
+}
@@ -0,0 +1,39 @@
+#ifndef PIE_BUILDLOG_HPP
+#define PIE_BUILDLOG_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/** BuildLog remembers how long each target took to run (wall time, in
+    milliseconds), so the next build knows which targets are the long poles.
+
+    It is a plain text file with one "<ms>\t<target>" line per target. Targets
+    that didn't run in a build keep their old entry.
+
+    e.g. .pie/log
+    1520	app
+    310	main.o */
+class BuildLog
+{
+public:
+    BuildLog(const std::string& path = ".pie/log");
+
+    /** read the log of the previous build, false if there is none */
+    bool load();
+    bool save();
+
+    /** milliseconds the target took last time, -1 if it never ran */
+    int64_t duration(const std::string& name);
+
+    /** remember that the target just ran for ms milliseconds (thread safe) */
+    void record(const std::string& name, int64_t ms);
+
+private:
+    std::string path;
+    std::mutex lock;
+    std::unordered_map<std::string, int64_t> durations;
+};
+
+#endif
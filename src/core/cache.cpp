@@ -0,0 +1,129 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+#include "cache.hpp"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+uint64_t hashString(const string& str, uint64_t seed)
+{
+    /** hash the terminating '\0' too, so "ab" + "c" != "a" + "bc" */
+    return hashBytes(str.c_str(), str.size() + 1, seed);
+}
+
+ActionCache::ActionCache(const string& dir): dir(dir) { }
+
+bool ActionCache::digest(const string& path, uint64_t& hash)
+{
+    {
+        lock_guard<mutex> guard(lock);
+        auto it = digests.find(path);
+        if (it != digests.end()) {
+            hash = it->second;
+            return true;
+        }
+    }
+
+    ifstream file(path, ios::binary);
+    if (!file)
+        return false;
+
+    char buffer[65536];
+    hash = hashString(path);
+    while (file) {
+        file.read(buffer, sizeof(buffer));
+        hash = hashBytes(buffer, file.gcount(), hash);
+    }
+    if (file.bad())
+        return false;
+
+    lock_guard<mutex> guard(lock);
+    digests[path] = hash;
+    return true;
+}
+
+bool ActionCache::key(const Target& tgt, const vector<string>& commands,
+                      string& key, const vector<string>& implicit)
+{
+    uint64_t hash = hashString(tgt.name);
+    for (const string& command : commands)
+        hash = hashString(command, hash);
+
+    for (const string& adj : tgt.adjacent) {
+        uint64_t input;
+        if (!digest(adj, input))
+            return false;
+        hash = hashBytes(&input, sizeof(input), hash);
+    }
+
+    for (const string& path : implicit) {
+        uint64_t input;
+        if (!digest(path, input))
+            return false;
+        hash = hashBytes(&input, sizeof(input), hash);
+    }
+
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+    key = hex;
+    return true;
+}
+
+bool ActionCache::restore(const string& key, const Target& tgt)
+{
+    error_code ec;
+    fs::path entry = fs::path(dir) / key;
+    if (!fs::is_regular_file(entry, ec))
+        return false;
+
+    fs::path output(tgt.name);
+    if (output.has_parent_path())
+        fs::create_directories(output.parent_path(), ec);
+    fs::copy_file(entry, output, fs::copy_options::overwrite_existing, ec);
+    if (ec)
+        return false;
+
+    /** the restored file counts as freshly built for the timestamp checks of
+        the targets depending on it */
+    fs::last_write_time(output, fs::file_time_type::clock::now(), ec);
+
+    lock_guard<mutex> guard(lock);
+    digests.erase(tgt.name);
+    return true;
+}
+
+void ActionCache::store(const string& key, const Target& tgt)
+{
+    error_code ec;
+    if (!fs::is_regular_file(tgt.name, ec))
+        return;
+
+    /** copy next to the entry first and rename it into place, so a build
+        that is interrupted never leaves a half written entry behind */
+    fs::create_directories(dir, ec);
+    fs::path entry = fs::path(dir) / key;
+    fs::path tmp = entry;
+    tmp += ".tmp";
+    fs::copy_file(tgt.name, tmp, fs::copy_options::overwrite_existing, ec);
+    if (!ec)
+        fs::rename(tmp, entry, ec);
+    if (ec)
+        fs::remove(tmp, ec);
+
+    lock_guard<mutex> guard(lock);
+    digests.erase(tgt.name);
+}
@@ -0,0 +1,61 @@
+#ifndef PIE_CACHE_HPP
+#define PIE_CACHE_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "target.hpp"
+
+/** 64 bit FNV-1a, a tiny and fast non-cryptographic hash. hashBytes() can be
+    chained by passing the previous result as seed */
+uint64_t hashBytes(const void* data, std::size_t size,
+                   uint64_t seed = 14695981039346656037ULL);
+uint64_t hashString(const std::string& str,
+                    uint64_t seed = 14695981039346656037ULL);
+
+/** ActionCache is a persistent, content addressed store of target outputs.
+
+    The key of a target combines its name and tasks (the command lines) with
+    a digest of the CONTENT of every input file it depends on. After a target
+    ran successfully, its output file (the file named like the target) is
+    copied into the cache directory under that key. The next time the same
+    commands would run on the same inputs, the file is copied back instead.
+
+    Unlike timestamps, this survives a fresh git clone or a CI machine that
+    starts from an empty tree, as long as the cache directory is kept.
+
+    e.g.
+    main.o: main.cpp              key = hash("main.o", tasks, main.cpp data)
+        g++ -c main.cpp -o main.o       -> .pie/cache/3f9c0d4e5a1b2c7d */
+class ActionCache
+{
+public:
+    ActionCache(const std::string& dir = ".pie/cache");
+
+    /** compute the key of tgt, returns false if the target can't be cached
+        because one of its inputs is not a file (e.g. a phony target).
+        commands are its tasks as they run (variables expanded), implicit
+        are the extra inputs found in its depfile last time */
+    bool key(const Target& tgt, const std::vector<std::string>& commands,
+             std::string& key, const std::vector<std::string>& implicit = {});
+
+    /** put the output recorded for key back in place, false on a miss */
+    bool restore(const std::string& key, const Target& tgt);
+
+    /** record the output of tgt (which just ran) under key */
+    void store(const std::string& key, const Target& tgt);
+
+private:
+    /** digest of a file's content, memoized since headers and libraries are
+        inputs of many targets */
+    bool digest(const std::string& path, uint64_t& hash);
+
+    std::string dir;
+    std::mutex lock;
+    std::unordered_map<std::string, uint64_t> digests;
+};
+
+#endif
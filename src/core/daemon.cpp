@@ -0,0 +1,293 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#include "daemon.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#ifndef MSG_CMSG_CLOEXEC
+#define MSG_CMSG_CLOEXEC 0
+#endif
+
+extern char** environ;
+#endif
+
+using namespace std;
+
+#ifdef _WIN32
+
+DaemonServer::~DaemonServer() { }
+bool DaemonServer::listen(const string&) { return false; }
+bool DaemonServer::accept(vector<string>&) { return false; }
+void DaemonServer::finish(int) { }
+bool daemonRequest(const vector<string>&, int&, const string&) { return false; }
+
+#else
+
+static bool socketAddress(const string& path, sockaddr_un& addr)
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+        return false;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+static int makeSocket()
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0)
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+static int connectTo(const string& path)
+{
+    sockaddr_un addr;
+    if (!socketAddress(path, addr))
+        return -1;
+    int fd = makeSocket();
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/** read or write all of "size" bytes */
+static bool readAll(int fd, void* data, size_t size)
+{
+    char* at = (char*)data;
+    while (size) {
+        ssize_t n = read(fd, at, size);
+        if (n <= 0)
+            return false;
+        at += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool sendAll(int fd, const void* data, size_t size)
+{
+    const char* at = (const char*)data;
+    while (size) {
+        ssize_t n = send(fd, at, size, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        at += n;
+        size -= n;
+    }
+    return true;
+}
+
+/** the strings separated by '\0' in text */
+static void splitText(const string& text, vector<string>& parts)
+{
+    parts.clear();
+    for (size_t begin = 0; begin < text.size(); ) {
+        size_t end = text.find('\0', begin);
+        if (end == string::npos)
+            end = text.size();
+        parts.push_back(text.substr(begin, end - begin));
+        begin = end + 1;
+    }
+}
+
+static vector<string> getEnvironment()
+{
+    vector<string> vars;
+    for (char** var = environ; *var; ++var)
+        vars.push_back(*var);
+    return vars;
+}
+
+/** replace the whole environment of this process with "vars" (NAME=value) */
+static void setEnvironment(const vector<string>& vars)
+{
+    for (const string& var : getEnvironment())
+        unsetenv(var.substr(0, var.find('=')).c_str());
+    for (const string& var : vars) {
+        string::size_type eq = var.find('=');
+        if (eq != string::npos && eq > 0)
+            setenv(var.substr(0, eq).c_str(), var.c_str() + eq + 1, 1);
+    }
+}
+
+DaemonServer::~DaemonServer()
+{
+    if (client >= 0)
+        finish(1);
+    if (fd >= 0) {
+        close(fd);
+        unlink(path.c_str());
+    }
+}
+
+bool DaemonServer::listen(const string& where)
+{
+    sockaddr_un addr;
+    if (!socketAddress(where, addr))
+        return false;
+
+    /** somebody answers: there's a daemon already. Otherwise the socket is
+        left over from one that died */
+    int other = connectTo(where);
+    if (other >= 0) {
+        close(other);
+        return false;
+    }
+    unlink(where.c_str());
+
+    error_code ec;
+    filesystem::path file(where);
+    if (file.has_parent_path())
+        filesystem::create_directories(file.parent_path(), ec);
+
+    fd = makeSocket();
+    if (fd < 0)
+        return false;
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(fd, 8) != 0) {
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    path = where;
+    return true;
+}
+
+bool DaemonServer::accept(vector<string>& args)
+{
+    for (;;) {
+        client = ::accept(fd, nullptr, nullptr);
+        if (client < 0)
+            return false;
+        fcntl(client, F_SETFD, FD_CLOEXEC);
+
+        /** the length comes with the file descriptors attached */
+        uint32_t length = 0;
+        int fds[3];
+        char control[CMSG_SPACE(sizeof(fds))];
+        iovec iov = { &length, sizeof(length) };
+        msghdr msg = {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        cmsghdr* cmsg = nullptr;
+        if (recvmsg(client, &msg, MSG_CMSG_CLOEXEC) == sizeof(length))
+            cmsg = CMSG_FIRSTHDR(&msg);
+
+        string text(length, '\0'), env;
+        uint32_t envLength = 0;
+        bool ok = cmsg && cmsg->cmsg_type == SCM_RIGHTS
+               && cmsg->cmsg_len == CMSG_LEN(sizeof(fds))
+               && readAll(client, &text[0], length)
+               && readAll(client, &envLength, sizeof(envLength));
+        if (ok) {
+            env.resize(envLength);
+            ok = readAll(client, &env[0], envLength);
+        }
+        if (!ok) {
+            /** a broken request, forget about it */
+            if (cmsg && cmsg->cmsg_type == SCM_RIGHTS)
+                for (size_t i = 0; i < (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int); ++i)
+                    close(((int*)CMSG_DATA(cmsg))[i]);
+            close(client);
+            client = -1;
+            continue;
+        }
+        memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+        splitText(text, args);
+        vector<string> vars;
+        splitText(env, vars);
+        environment = getEnvironment();
+        setEnvironment(vars);
+
+        fflush(stdout);
+        fflush(stderr);
+        for (int i = 0; i < 3; ++i) {
+            saved[i] = fcntl(i, F_DUPFD_CLOEXEC, 3);
+            dup2(fds[i], i);
+            close(fds[i]);
+        }
+        return true;
+    }
+}
+
+void DaemonServer::finish(int status)
+{
+    fflush(stdout);
+    fflush(stderr);
+    for (int i = 0; i < 3; ++i) {
+        dup2(saved[i], i);
+        close(saved[i]);
+        saved[i] = -1;
+    }
+    setEnvironment(environment);
+    environment.clear();
+
+    int32_t answer = status;
+    sendAll(client, &answer, sizeof(answer));
+    close(client);
+    client = -1;
+}
+
+bool daemonRequest(const vector<string>& args, int& status, const string& path)
+{
+    int fd = connectTo(path);
+    if (fd < 0)
+        return false;
+
+    string text, env;
+    for (const string& arg : args)
+        text += arg + '\0';
+    for (const string& var : getEnvironment())
+        env += var + '\0';
+    uint32_t length = text.size(), envLength = env.size();
+
+    int fds[3] = { 0, 1, 2 };
+    char control[CMSG_SPACE(sizeof(fds))] = {};
+    iovec iov = { &length, sizeof(length) };
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    int32_t answer = 1;
+    if (sendmsg(fd, &msg, MSG_NOSIGNAL) != sizeof(length)
+        || !sendAll(fd, text.data(), text.size())
+        || !sendAll(fd, &envLength, sizeof(envLength))
+        || !sendAll(fd, env.data(), env.size())
+        || !readAll(fd, &answer, sizeof(answer))) {
+        fprintf(stderr, "Error: lost the connection to the daemon\n");
+        answer = 1;
+    }
+    close(fd);
+
+    status = answer;
+    return true;
+}
+
+#endif
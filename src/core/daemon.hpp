@@ -0,0 +1,60 @@
+#ifndef PIE_DAEMON_HPP
+#define PIE_DAEMON_HPP
+
+#include <string>
+#include <vector>
+
+/** The daemon is a pie process that stays running in the project directory
+    (pie --daemon) and runs the command lines of clients (pie --client ...)
+    one at a time, so what it loaded for the first one, e.g. the parsed
+    Piefile, is already there for the next.
+
+    A client connects to the Unix socket .pie/daemon.sock and sends its
+    command line together with its stdin, stdout and stderr (passed as file
+    descriptors, SCM_RIGHTS) and its environment. The daemon puts those in
+    place of its own while it runs the command, so tasks print straight to
+    the client's terminal and see the client's PATH, MAKEFLAGS and so on,
+    then answers with the exit status:
+
+    client -> daemon   uint32 length, args separated by '\0', 3 fds,
+                       uint32 length, environment separated by '\0'
+    daemon -> client   int32 exit status
+
+    A jobserver passed as file descriptors (see Jobserver::passedAsFds) only
+    works in the client's own process, such a client doesn't use the daemon.
+
+    Windows has no SCM_RIGHTS, so there is no daemon there. */
+static const char* const DAEMON_SOCKET = ".pie/daemon.sock";
+
+class DaemonServer
+{
+public:
+    ~DaemonServer();
+
+    /** start listening, replacing the socket of a daemon that died; fails if
+        another daemon is already serving this directory */
+    bool listen(const std::string& path = DAEMON_SOCKET);
+
+    /** wait for the next client and swap in its stdin, stdout, stderr and
+        environment, returns false if accepting failed */
+    bool accept(std::vector<std::string>& args);
+
+    /** swap our own stdin, stdout, stderr and environment back and answer
+        the client */
+    void finish(int status);
+
+private:
+    int fd = -1;
+    int client = -1;
+    int saved[3] = { -1, -1, -1 };
+    std::vector<std::string> environment;  /** our own, while a client's is in place */
+    std::string path;
+};
+
+/** have the daemon run "args" with our stdin, stdout, stderr and
+    environment, returns false if no daemon is listening. A daemon that goes
+    away before answering counts as status 1 */
+bool daemonRequest(const std::vector<std::string>& args, int& status,
+                   const std::string& path = DAEMON_SOCKET);
+
+#endif
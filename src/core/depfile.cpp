@@ -0,0 +1,118 @@
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+#include "depfile.hpp"
+
+using namespace std;
+
+bool parseDepfile(string_view text, vector<string>& deps)
+{
+    string word;
+    bool rules = false;     /** seen the colon after the target(s) */
+
+    auto flush = [&] {
+        if (!word.empty() && rules)
+            deps.push_back(word);
+        word.clear();
+    };
+
+    for (size_t i = 0; i < text.size(); ++i) {
+        char c = text[i];
+        if (c == '\\' && i + 1 < text.size()) {
+            char n = text[i + 1];
+            if (n == '\n' || (n == '\r' && i + 2 < text.size() && text[i + 2] == '\n')) {
+                /** line continuation */
+                flush();
+                i += n == '\r' ? 2 : 1;
+                continue;
+            }
+            if (n == ' ' || n == '#' || n == '\\') {
+                word += n;
+                ++i;
+                continue;
+            }
+            word += c;
+        } else if (c == '$' && i + 1 < text.size() && text[i + 1] == '$') {
+            word += '$';
+            ++i;
+        } else if (c == ':' && !rules
+                   && (i + 1 == text.size() || text[i + 1] == ' '
+                       || text[i + 1] == '\t' || text[i + 1] == '\n'
+                       || text[i + 1] == '\r')) {
+            /** a colon followed by a space ends the target list (a colon in
+                "C:\path" doesn't) */
+            word.clear();
+            rules = true;
+        } else if (c == ' ' || c == '\t' || c == '\r') {
+            flush();
+        } else if (c == '\n') {
+            /** with -MP, every header gets an empty rule of its own, those
+                repeat names we already have */
+            flush();
+            if (rules)
+                break;
+        } else {
+            word += c;
+        }
+    }
+    flush();
+    return rules;
+}
+
+DepsLog::DepsLog(const string& path): path(path) { }
+
+bool DepsLog::load()
+{
+    ifstream file(path);
+    if (!file)
+        return false;
+
+    string line;
+    vector<string>* current = nullptr;
+    while (getline(file, line)) {
+        if (line.empty())
+            continue;
+        if (line[0] == '\t') {
+            if (current)
+                current->push_back(line.substr(1));
+        } else {
+            current = &entries[line];
+            current->clear();
+        }
+    }
+    return true;
+}
+
+bool DepsLog::save()
+{
+    error_code ec;
+    filesystem::path file(path);
+    if (file.has_parent_path())
+        filesystem::create_directories(file.parent_path(), ec);
+
+    lock_guard<mutex> guard(lock);
+    ofstream out(path, ios::trunc);
+    for (auto& p : entries) {
+        out << p.first << '\n';
+        for (const string& dep : p.second)
+            out << '\t' << dep << '\n';
+    }
+    return bool(out);
+}
+
+vector<string> DepsLog::get(const string& name)
+{
+    lock_guard<mutex> guard(lock);
+    auto it = entries.find(name);
+    return it == entries.end() ? vector<string>() : it->second;
+}
+
+void DepsLog::set(const string& name, vector<string> deps)
+{
+    lock_guard<mutex> guard(lock);
+    if (deps.empty())
+        entries.erase(name);
+    else
+        entries[name] = move(deps);
+}
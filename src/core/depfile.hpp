@@ -0,0 +1,51 @@
+#ifndef PIE_DEPFILE_HPP
+#define PIE_DEPFILE_HPP
+
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/** read the prerequisites out of a Make-style depfile, like the ones written
+    by gcc/clang -MMD:
+
+    main.o: main.cpp include/util.hpp \
+      include/config.hpp
+
+    everything after the colon is a dependency; backslash-newline continues
+    the line and "\ " is a space inside a path. Returns false if the text
+    has no "target:" part */
+bool parseDepfile(std::string_view text, std::vector<std::string>& deps);
+
+/** DepsLog keeps the implicit dependencies (e.g. headers) found in each
+    target's depfile, so the next build can check them for staleness without
+    the Piefile having to list them.
+
+    It's a text file in .pie written in Piefile style, the target name and
+    then its dependencies on tab-indented lines:
+
+    main.o
+    	main.cpp
+    	include/util.hpp */
+class DepsLog
+{
+public:
+    DepsLog(const std::string& path = ".pie/deps");
+
+    bool load();
+    bool save();
+
+    /** the dependencies recorded for name (empty if there are none) */
+    std::vector<std::string> get(const std::string& name);
+
+    /** replace what's recorded for name (thread safe) */
+    void set(const std::string& name, std::vector<std::string> deps);
+
+private:
+    std::string path;
+    std::mutex lock;
+    std::unordered_map<std::string, std::vector<std::string>> entries;
+};
+
+#endif
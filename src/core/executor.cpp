@@ -0,0 +1,140 @@
+#include <thread>
+
+#include "executor.hpp"
+
+using namespace std;
+
+Executor::Executor(const BuildGraph& graph, unsigned int jobs)
+    : graph(graph), jobs(jobs ? jobs : 1)
+{
+}
+
+bool Executor::run(const vector<BuildGraph::Id>& order, const Job& job)
+{
+    /** dependencies that are not in the order (e.g. plain files) are treated
+        as already satisfied */
+    wanted.assign(graph.size(), 0);
+    pending.assign(graph.size(), 0);
+    for (BuildGraph::Id id : order)
+        wanted[id] = 1;
+
+    /** critical path: walk the order backwards, so every target sees the
+        final priority of the targets depending on it */
+    priority.assign(graph.size(), 0);
+    if (!weights.empty()) {
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            uint64_t longest = 0;
+            for (BuildGraph::Id user : graph.dependents(*it))
+                if (wanted[user] && priority[user] > longest)
+                    longest = priority[user];
+            priority[*it] = weights[*it] + longest;
+        }
+    }
+
+    if (trace)
+        readyAt.assign(graph.size(), 0);
+
+    ready = priority_queue<Ready>();
+    seq = 0;
+    for (BuildGraph::Id id : order) {
+        for (BuildGraph::Id dep : graph.deps(id))
+            if (wanted[dep])
+                ++pending[id];
+        if (!pending[id])
+            push(id);
+    }
+
+    total = order.size();
+    finished = running = 0;
+    failed = false;
+
+    unsigned int count = jobs < total ? jobs : total;
+    if (trace)
+        for (unsigned int i = 0; i < count; ++i)
+            trace->track(i, "worker " + to_string(i));
+
+    /** -j 1 keeps the old behaviour of running everything on this thread */
+    if (jobs == 1) {
+        worker(job, 0);
+        return !failed;
+    }
+
+    vector<thread> pool;
+    for (unsigned int i = 0; i < count; ++i)
+        pool.emplace_back(&Executor::worker, this, cref(job), i);
+    for (thread& t : pool)
+        t.join();
+
+    return !failed;
+}
+
+void Executor::setWeights(vector<uint64_t> w)
+{
+    weights = move(w);
+    weights.resize(graph.size(), 0);
+}
+
+void Executor::setTrace(Trace* t)
+{
+    trace = t;
+}
+
+void Executor::push(BuildGraph::Id id)
+{
+    ready.push(Ready{ priority[id], seq++, id });
+    if (trace) {
+        readyAt[id] = trace->now();
+        trace->counter("ready", readyAt[id], ready.size());
+    }
+}
+
+/** pop a ready target, run it, then release the targets waiting on it. A
+    worker exits once everything finished, or after a failure once nothing
+    is left running */
+void Executor::worker(const Job& job, unsigned int slot)
+{
+    unique_lock<mutex> guard(lock);
+    for (;;) {
+        wake.wait(guard, [this] {
+            return (!ready.empty() && !failed)
+                || finished == total
+                || (failed && !running)
+                || (ready.empty() && !running);
+        });
+
+        if (failed || ready.empty())
+            break;
+
+        BuildGraph::Id id = ready.top().id;
+        ready.pop();
+        ++running;
+
+        Trace::Micros start = 0;
+        if (trace) {
+            start = trace->now();
+            trace->counter("ready", start, ready.size());
+        }
+
+        guard.unlock();
+        bool ok = job(*graph.target(id), slot);
+        guard.lock();
+
+        if (trace)
+            trace->span(graph.name(id), "target", slot, start, trace->now(),
+                        "\"wait_us\": " + to_string(start - readyAt[id])
+                        + ", \"ok\": " + (ok ? "true" : "false"));
+
+        --running;
+        ++finished;
+        if (!ok)
+            failed = true;
+
+        for (BuildGraph::Id user : graph.dependents(id))
+            if (wanted[user] && !--pending[user])
+                push(user);
+
+        wake.notify_all();
+    }
+
+    wake.notify_all();
+}
@@ -0,0 +1,100 @@
+#ifndef PIE_EXECUTOR_HPP
+#define PIE_EXECUTOR_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "graph.hpp"
+#include "target.hpp"
+#include "trace.hpp"
+
+/** Executor runs the targets of a BuildGraph on a pool of worker threads.
+
+    Every target gets an in-degree: the number of its adjacent targets (i.e.
+    dependencies) that still have to finish. Targets whose in-degree is 0 sit
+    in the ready queue, and whenever a worker finishes a target it decrements
+    the in-degree of everything that depends on it, pushing the ones that
+    reach 0. Independent subtrees of the DAG therefore build concurrently.
+
+    e.g.
+    app: a.o b.o      a.o and b.o start right away on two workers,
+    a.o: a.cpp        app is queued as soon as the second one is done
+    b.o: b.cpp
+
+    When several targets are ready at once, the one with the longest
+    remaining critical path is started first: its own weight (how long it
+    took last time, see setWeights) plus the heaviest chain of targets that
+    are waiting on it. That way a slow link step at the end of a long chain
+    isn't left until the very end. Without weights, ready targets start in
+    the order they became ready.
+
+    Workers are numbered 0 .. jobs-1 (their "slot"), which is passed to the
+    job so it can e.g. label its own trace spans. */
+class Executor
+{
+public:
+    /** called for each target with the slot of the worker running it,
+        returns whether the target succeeded */
+    typedef std::function<bool(Target&, unsigned int)> Job;
+
+    Executor(const BuildGraph& graph, unsigned int jobs);
+
+    /** run every target in order (a topological order), returns false if any
+        of them failed. Like Make, a failure stops new targets from being
+        started but lets the running ones finish */
+    bool run(const std::vector<BuildGraph::Id>& order, const Job& job);
+
+    /** expected cost of each target (indexed by graph id), e.g. its duration
+        from the last build; 0 for targets nothing is known about */
+    void setWeights(std::vector<uint64_t> weights);
+
+    /** record a span per target (with the time it waited in the ready
+        queue) and the length of the ready queue into "trace" */
+    void setTrace(Trace* trace);
+
+private:
+    struct Ready {
+        uint64_t priority;  /** length of the critical path from here */
+        uint64_t seq;       /** FIFO among equal priorities */
+        BuildGraph::Id id;
+
+        bool operator<(const Ready& r) const
+        {
+            return priority != r.priority ? priority < r.priority : seq > r.seq;
+        }
+    };
+
+    void worker(const Job& job, unsigned int slot);
+    void push(BuildGraph::Id id);
+
+    const BuildGraph& graph;
+    unsigned int jobs;
+
+    /** per graph node: whether it's part of this run, and how many of its
+        dependencies in this run haven't finished yet */
+    std::vector<char> wanted;
+    std::vector<BuildGraph::Id> pending;
+    std::size_t total = 0;
+
+    std::vector<uint64_t> weights;
+    std::vector<uint64_t> priority;
+    std::priority_queue<Ready> ready;
+    uint64_t seq = 0;
+    std::size_t finished = 0;
+    std::size_t running = 0;
+    bool failed = false;
+
+    Trace* trace = nullptr;
+    std::vector<Trace::Micros> readyAt;
+
+    std::mutex lock;
+    std::condition_variable wake;
+};
+
+#endif
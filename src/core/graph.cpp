@@ -0,0 +1,144 @@
+#include "graph.hpp"
+
+using namespace std;
+
+BuildGraph::Id BuildGraph::intern(const string& name)
+{
+    auto it = ids.emplace(name, names.size());
+    if (it.second) {
+        names.push_back(&name);
+        targets.push_back(nullptr);
+    }
+    return it.first->second;
+}
+
+BuildGraph::BuildGraph(TargetMap& nodes)
+{
+    size_t edgeCount = 0;
+    for (auto& p : nodes)
+        edgeCount += p.second.adjacent.size();
+
+    /** targets get the first ids, so targets[] is filled in one go and
+        everything interned after them is a plain file */
+    ids.reserve(nodes.size() + edgeCount / 4);
+    names.reserve(nodes.size());
+    targets.reserve(nodes.size());
+    for (auto& p : nodes)
+        targets[intern(p.first)] = &p.second;
+
+    /** forward edges: the adjacent names of each target, in Piefile order.
+        Only targets have edges, so walk them by id */
+    size_t declared = names.size();
+    offsets.assign(1, 0);
+    edges.reserve(edgeCount);
+    for (Id id = 0; id < declared; ++id) {
+        for (const string& adj : targets[id]->adjacent)
+            edges.push_back(intern(adj));
+        offsets.push_back(edges.size());
+    }
+    offsets.resize(names.size() + 1, edges.size());
+
+    /** reverse edges via counting sort: count, prefix sum, then place */
+    roffsets.assign(names.size() + 1, 0);
+    for (Id dep : edges)
+        ++roffsets[dep + 1];
+    for (size_t i = 1; i < roffsets.size(); ++i)
+        roffsets[i] += roffsets[i - 1];
+
+    redges.resize(edges.size());
+    vector<Id> fill(roffsets.begin(), roffsets.end() - 1);
+    for (Id id = 0; id < declared; ++id)
+        for (Id dep : deps(id))
+            redges[fill[dep]++] = id;
+}
+
+BuildGraph::Id BuildGraph::find(string_view name) const
+{
+    auto it = ids.find(name);
+    return it == ids.end() ? NONE : it->second;
+}
+
+bool BuildGraph::sort(const vector<Id>& roots, vector<Id>& order,
+                      vector<Id>& cycle) const
+{
+    /** 1) mark what we have to sort: everything, or the closure of roots
+        (iterative DFS, so long dependency chains can't overflow the stack) */
+    vector<char> wanted(size(), 0);
+    size_t count = 0;
+    if (roots.empty()) {
+        for (Id id = 0; id < size(); ++id)
+            if (targets[id]) { wanted[id] = 1; ++count; }
+    } else {
+        vector<Id> stack;
+        for (Id root : roots) {
+            if (wanted[root] || !targets[root])
+                continue;
+            wanted[root] = 1;
+            stack.push_back(root);
+            while (!stack.empty()) {
+                Id id = stack.back();
+                stack.pop_back();
+                ++count;
+                for (Id dep : deps(id)) {
+                    if (!wanted[dep] && targets[dep]) {
+                        wanted[dep] = 1;
+                        stack.push_back(dep);
+                    }
+                }
+            }
+        }
+    }
+
+    /** 2) in-degree = number of wanted targets each target depends on */
+    vector<Id> pending(size(), 0);
+    order.clear();
+    order.reserve(count);
+    for (Id id = 0; id < size(); ++id) {
+        if (!wanted[id])
+            continue;
+        for (Id dep : deps(id))
+            if (wanted[dep])
+                ++pending[id];
+        if (!pending[id])
+            order.push_back(id);
+    }
+
+    /** 3) Kahn: order doubles as the queue, everything before "head" is
+        done, everything after it is ready */
+    size_t head = 0;
+    while (head < order.size()) {
+        Id id = order[head++];
+        for (Id user : dependents(id))
+            if (wanted[user] && !--pending[user])
+                order.push_back(user);
+    }
+
+    /** 4) leftovers all wait on each other. Each of them has a pending
+        dependency that is itself a leftover, so following those must come
+        back to a node we already walked through */
+    if (order.size() == count)
+        return true;
+
+    Id start = NONE;
+    for (Id id = 0; id < size() && start == NONE; ++id)
+        if (wanted[id] && pending[id])
+            start = id;
+
+    vector<size_t> seen(size(), SIZE_MAX);
+    vector<Id> path;
+    Id id = start;
+    while (seen[id] == SIZE_MAX) {
+        seen[id] = path.size();
+        path.push_back(id);
+        for (Id dep : deps(id)) {
+            if (wanted[dep] && pending[dep]) {
+                id = dep;
+                break;
+            }
+        }
+    }
+
+    cycle.assign(path.begin() + seen[id], path.end());
+    cycle.push_back(id);
+    return false;
+}
@@ -0,0 +1,86 @@
+#ifndef PIE_GRAPH_HPP
+#define PIE_GRAPH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "target.hpp"
+
+/** BuildGraph is a compact, integer keyed view of a TargetMap.
+
+    Every target name and every dependency name is interned once into an Id
+    (0, 1, 2, ...), so walking the graph never hashes a string again. The
+    edges are stored in CSR ("compressed sparse row") form: the dependencies
+    of node i are edges[offsets[i]] .. edges[offsets[i + 1] - 1], all in one
+    flat array. The reverse edges (who depends on i) are stored the same way.
+
+    e.g.
+    app: a.o b.o        ids:  app=0 a.o=1 b.o=2 a.cpp=3 b.cpp=4
+    a.o: a.cpp          deps: offsets = [0, 2, 3, 4, 4, 4]
+    b.o: b.cpp                edges   = [1, 2, 3, 4]
+
+    Dependencies that are not targets (a.cpp, b.cpp) are nodes too, they just
+    have no Target and nothing to run.
+
+    The graph only points into the TargetMap (names are not copied), so the
+    map must outlive the graph and must not be modified while it's in use. */
+class BuildGraph
+{
+public:
+    typedef uint32_t Id;
+    static const Id NONE = UINT32_MAX;
+
+    /** a [begin, end) range of ids, usable in a range-for */
+    struct Range {
+        const Id* first;
+        const Id* last;
+        const Id* begin() const { return first; }
+        const Id* end() const { return last; }
+        std::size_t size() const { return last - first; }
+    };
+
+    explicit BuildGraph(TargetMap& nodes);
+
+    std::size_t size() const { return names.size(); }
+
+    /** id of a name, NONE if it appears nowhere in the Piefile */
+    Id find(std::string_view name) const;
+    const std::string& name(Id id) const { return *names[id]; }
+
+    /** the Target of id, nullptr if id is a plain file */
+    Target* target(Id id) const { return targets[id]; }
+
+    Range deps(Id id) const
+    {
+        return Range{ edges.data() + offsets[id], edges.data() + offsets[id + 1] };
+    }
+    Range dependents(Id id) const
+    {
+        return Range{ redges.data() + roffsets[id], redges.data() + roffsets[id + 1] };
+    }
+
+    /** topologically sort the targets reachable from roots (every target if
+        roots is empty) with Kahn's algorithm: repeatedly take a target whose
+        dependencies are all done. Plain files are left out of order.
+
+        If targets remain that never become ready, they depend on each other;
+        sort() returns false and fills cycle with the ids along one cycle
+        (e.g. [a, b, c, a] for a: b, b: c, c: a) */
+    bool sort(const std::vector<Id>& roots, std::vector<Id>& order,
+              std::vector<Id>& cycle) const;
+
+private:
+    Id intern(const std::string& name);
+
+    std::unordered_map<std::string_view, Id> ids;
+    std::vector<const std::string*> names;
+    std::vector<Target*> targets;
+    std::vector<Id> offsets, edges;
+    std::vector<Id> roffsets, redges;
+};
+
+#endif
@@ -0,0 +1,259 @@
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+
+#include "cache.hpp"
+#include "graphdb.hpp"
+#include "mapped.hpp"
+#include "timestamp.hpp"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static const char MAGIC[4] = { 'P', 'I', 'E', 'G' };
+static const uint32_t VERSION = 3;
+
+struct GraphHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t size;      /** of the Piefile */
+    int64_t mtime;      /** of the Piefile, file_time_type ticks */
+    uint64_t hash;      /** of the Piefile's content */
+    uint32_t strings;
+    uint32_t targets;
+    uint32_t variables;
+    uint32_t order;
+    uint32_t words;     /** uint32s in the targets section */
+    uint64_t blob;      /** bytes of string data */
+};
+
+/** stat the Piefile, the hash is only computed when asked for */
+static bool statPiefile(const string& piefile, GraphHeader& h)
+{
+    error_code ec;
+    h.size = fs::file_size(piefile, ec);
+    if (ec)
+        return false;
+
+    TimeStamp stamp;
+    if (!fileTime(piefile, stamp))
+        return false;
+    h.mtime = stamp.time_since_epoch().count();
+    return true;
+}
+
+static bool hashPiefile(const string& piefile, uint64_t& hash)
+{
+    MappedFile file;
+    if (!file.open(piefile))
+        return false;
+    hash = hashBytes(file.data(), file.size());
+    return true;
+}
+
+/** bounds checked reader over the mapped database */
+struct Reader
+{
+    const char* p;
+    const char* end;
+
+    bool u32(uint32_t& v)
+    {
+        if (end - p < (ptrdiff_t)sizeof(v))
+            return false;
+        memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        return true;
+    }
+};
+
+bool loadGraph(const string& piefile, TargetMap& nodes, Variables& vars,
+               vector<string>& order, const string& db)
+{
+    MappedFile file;
+    if (!file.open(db) || file.size() < sizeof(GraphHeader))
+        return false;
+
+    GraphHeader h;
+    memcpy(&h, file.data(), sizeof(h));
+    if (memcmp(h.magic, MAGIC, sizeof(MAGIC)) || h.version != VERSION)
+        return false;
+
+    GraphHeader now;
+    if (!statPiefile(piefile, now) || now.size != h.size)
+        return false;
+
+    /** touched but not edited, check the content and remember the new mtime
+        so the next run takes the fast path again */
+    if (now.mtime != h.mtime) {
+        uint64_t hash;
+        if (!hashPiefile(piefile, hash) || hash != h.hash)
+            return false;
+
+        h.mtime = now.mtime;
+        fstream out(db, ios::in | ios::out | ios::binary);
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    }
+
+    /** locate the sections and make sure they fit in the file */
+    Reader r{ file.data() + sizeof(h), file.data() + file.size() };
+    uint64_t fixed = (uint64_t)h.strings * 8 + (uint64_t)h.words * 4
+                   + (uint64_t)h.order * 4 + h.blob;
+    if (fixed != (uint64_t)(r.end - r.p))
+        return false;
+
+    const char* blob = r.end - h.blob;
+    vector<string_view> strings(h.strings);
+    for (uint32_t i = 0; i < h.strings; ++i) {
+        uint32_t offset = 0, length = 0;
+        r.u32(offset); r.u32(length);
+        if ((uint64_t)offset + length > h.blob)
+            return false;
+        strings[i] = string_view(blob + offset, length);
+    }
+
+    const char* orderBegin = r.p + (uint64_t)h.words * 4;
+    Reader section{ r.p, orderBegin };
+    auto str = [&](string& out) {
+        uint32_t id;
+        if (!section.u32(id) || id >= h.strings)
+            return false;
+        out.assign(strings[id]);
+        return true;
+    };
+
+    /** read into locals and only hand them over once everything checked
+        out, a corrupt database leaves the caller's containers alone */
+    TargetMap loaded;
+    loaded.reserve(h.targets);
+    for (uint32_t i = 0; i < h.targets; ++i) {
+        string name;
+        uint32_t adjacent, tasks;
+        if (!str(name) || !section.u32(adjacent) || !section.u32(tasks))
+            return false;
+
+        Target& tgt = loaded.emplace(name, name).first->second;
+        tgt.adjacent.resize(adjacent);
+        tgt.tasks.resize(tasks);
+        for (string& adj : tgt.adjacent)
+            if (!str(adj))
+                return false;
+        for (string& task : tgt.tasks)
+            if (!str(task))
+                return false;
+        if (!str(tgt.depfile))
+            return false;
+    }
+
+    vector<pair<string, string>> definitions(h.variables);
+    for (auto& def : definitions)
+        if (!str(def.first) || !str(def.second))
+            return false;
+
+    section = Reader{ orderBegin, orderBegin + (uint64_t)h.order * 4 };
+    vector<string> names(h.order);
+    unordered_map<string_view, uint32_t> position;
+    for (string& name : names)
+        if (!str(name) || !loaded.count(name)
+                || !position.emplace(name, position.size()).second)
+            return false;
+
+    /** the order has to be one: every target after the targets it needs */
+    for (auto& p : position)
+        for (const string& adj : loaded.at(string(p.first)).adjacent) {
+            auto dep = position.find(adj);
+            if (dep != position.end() && dep->second > p.second)
+                return false;
+        }
+
+    nodes.swap(loaded);
+    order.swap(names);
+    for (auto& def : definitions)
+        vars.define(def.first, move(def.second));
+    return true;
+}
+
+bool saveGraph(const string& piefile, const TargetMap& nodes,
+               const Variables& vars, const vector<string>& order,
+               const string& db)
+{
+    GraphHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    if (!statPiefile(piefile, h) || !hashPiefile(piefile, h.hash))
+        return false;
+
+    /** intern every string, each distinct one is stored once */
+    unordered_map<string_view, uint32_t> ids;
+    vector<string_view> strings;
+    vector<uint32_t> words, orderIds;
+    string blob;
+    auto intern = [&](const string& s) {
+        auto it = ids.emplace(s, strings.size());
+        if (it.second)
+            strings.push_back(s);
+        return it.first->second;
+    };
+
+    for (auto& p : nodes) {
+        const Target& tgt = p.second;
+        words.push_back(intern(tgt.name));
+        words.push_back(tgt.adjacent.size());
+        words.push_back(tgt.tasks.size());
+        for (const string& adj : tgt.adjacent)
+            words.push_back(intern(adj));
+        for (const string& task : tgt.tasks)
+            words.push_back(intern(task));
+        words.push_back(intern(tgt.depfile));
+    }
+    for (auto& p : vars.definitions()) {
+        words.push_back(intern(p.first));
+        words.push_back(intern(p.second));
+    }
+    for (const string& name : order)
+        orderIds.push_back(intern(name));
+
+    vector<uint32_t> index;
+    index.reserve(strings.size() * 2);
+    for (string_view s : strings) {
+        index.push_back(blob.size());
+        index.push_back(s.size());
+        blob.append(s);
+    }
+
+    h.strings = strings.size();
+    h.targets = nodes.size();
+    h.variables = vars.definitions().size();
+    h.order = orderIds.size();
+    h.words = words.size();
+    h.blob = blob.size();
+
+    /** write next to the database and rename, so a reader never sees a half
+        written file */
+    error_code ec;
+    fs::path path(db);
+    if (path.has_parent_path())
+        fs::create_directories(path.parent_path(), ec);
+    fs::path tmp = path;
+    tmp += ".tmp";
+
+    {
+        ofstream out(tmp, ios::binary | ios::trunc);
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        out.write(reinterpret_cast<const char*>(index.data()), index.size() * 4);
+        out.write(reinterpret_cast<const char*>(words.data()), words.size() * 4);
+        out.write(reinterpret_cast<const char*>(orderIds.data()), orderIds.size() * 4);
+        out.write(blob.data(), blob.size());
+        if (!out)
+            return false;
+    }
+
+    fs::rename(tmp, path, ec);
+    return !ec;
+}
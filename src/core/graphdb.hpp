@@ -0,0 +1,45 @@
+#ifndef PIE_GRAPHDB_HPP
+#define PIE_GRAPHDB_HPP
+
+#include <string>
+#include <vector>
+
+#include "target.hpp"
+#include "variables.hpp"
+
+/** The graph database is a binary snapshot of a parsed Piefile: every
+    Target with its adjacent targets and tasks, its variables, plus the
+    topological order.
+    It lets an unchanged Piefile skip readFile() -> parseTargets() ->
+    sortTargets() entirely.
+
+    The file is keyed by the size, modification time and content hash of the
+    Piefile it came from. Size + mtime is the fast path; if only the mtime
+    changed (a touch, a git checkout) the hash decides and the key is
+    refreshed.
+
+    Layout (native byte order, all counts and ids are uint32):
+
+    header   magic "PIEG", version, Piefile size/mtime/hash, counts
+    strings  (offset, length) of every distinct string in the blob
+    targets  name id, #adjacent, #tasks, adjacent ids..., task ids...,
+             depfile id (the empty string if there's none)
+             then name id, value id of every variable
+    order    target name ids in topological order
+    blob     the characters of all strings, back to back
+
+    The database is only ever a cache: if it is missing, stale or corrupt,
+    loadGraph() returns false and the Piefile is parsed as usual. */
+
+/** fill nodes, vars and order from db if it matches piefile */
+bool loadGraph(const std::string& piefile, TargetMap& nodes, Variables& vars,
+               std::vector<std::string>& order,
+               const std::string& db = ".pie/graph.db");
+
+/** write nodes, vars and order to db, keyed by the current state of
+    piefile */
+bool saveGraph(const std::string& piefile, const TargetMap& nodes,
+               const Variables& vars, const std::vector<std::string>& order,
+               const std::string& db = ".pie/graph.db");
+
+#endif
@@ -0,0 +1,201 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+#include "jobserver.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/** words of MAKEFLAGS up to "--", after which make puts variable overrides */
+static void splitFlags(const char* flags, vector<string>& words, string& overrides)
+{
+    istringstream in(flags ? flags : "");
+    string word;
+    while (in >> word) {
+        if (word == "--") {
+            getline(in, overrides);
+            overrides = " --" + overrides;
+            break;
+        }
+        words.push_back(word);
+    }
+}
+
+/** the pool of --jobserver-auth=... in MAKEFLAGS, and its -j in size */
+static string findAuth(const char* flags, unsigned int& size)
+{
+    vector<string> words;
+    string overrides, auth;
+    splitFlags(flags, words, overrides);
+    for (const string& word : words) {
+        if (word.compare(0, 17, "--jobserver-auth=") == 0)
+            auth = word.substr(17);
+        else if (word.compare(0, 16, "--jobserver-fds=") == 0)   /** make < 4.2 */
+            auth = word.substr(16);
+        else if (word.compare(0, 2, "-j") == 0)
+            size = atoi(word.c_str() + 2);
+    }
+    return auth;
+}
+
+bool Jobserver::passedAsFds()
+{
+    unsigned int size;
+    string auth = findAuth(getenv("MAKEFLAGS"), size);
+    return !auth.empty() && auth.compare(0, 5, "fifo:") != 0;
+}
+
+#ifdef _WIN32
+
+Jobserver::~Jobserver() { }
+bool Jobserver::join() { return false; }
+bool Jobserver::create(unsigned int) { return false; }
+char Jobserver::acquire() { return 0; }
+void Jobserver::release(char) { }
+void Jobserver::close() { }
+
+#else
+
+/** our own non-blocking read end: a pipe's file description is shared with
+    every other make reading from it, so it can't be made non-blocking
+    itself. On Linux, opening /proc/self/fd/N gives a new description of the
+    same pipe; elsewhere we have to make do with a blocking one */
+static int openReader(int fd)
+{
+    int own = open(("/proc/self/fd/" + to_string(fd)).c_str(),
+                   O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (own >= 0)
+        return own;
+    own = dup(fd);
+    if (own >= 0)
+        fcntl(own, F_SETFD, FD_CLOEXEC);
+    return own;
+}
+
+Jobserver::~Jobserver()
+{
+    close();
+}
+
+void Jobserver::close()
+{
+    if (readFd >= 0)
+        ::close(readFd);
+    if (owner) {
+        ::close(pipeFds[0]);
+        ::close(pipeFds[1]);
+        if (hadFlags)
+            setenv("MAKEFLAGS", savedFlags.c_str(), 1);
+        else
+            unsetenv("MAKEFLAGS");
+    }
+    readFd = writeFd = -1;
+    owner = false;
+}
+
+bool Jobserver::join()
+{
+    string auth = findAuth(getenv("MAKEFLAGS"), size);
+    if (auth.empty())
+        return false;
+
+    if (auth.compare(0, 5, "fifo:") == 0) {
+        fifo = auth.substr(5);
+        readFd = writeFd = open(fifo.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    } else {
+        int r, w;
+        if (sscanf(auth.c_str(), "%d,%d", &r, &w) != 2)
+            return false;
+        /** make closes the pipe for commands it doesn't know are recursive */
+        if (fcntl(r, F_GETFD) == -1 || fcntl(w, F_GETFD) == -1) {
+            fprintf(stderr, "Warning: jobserver unavailable: using -j1. "
+                            "Add '+' to parent make rule.\n");
+            return false;
+        }
+        readFd = openReader(r);
+        writeFd = w;
+    }
+
+    return readFd >= 0;
+}
+
+/** a plain pipe rather than a fifo, so that make < 4.4 can join it too */
+bool Jobserver::create(unsigned int jobs)
+{
+    if (jobs <= 1 || pipe(pipeFds) != 0)
+        return false;
+    const char* parent = getenv("MAKEFLAGS");
+    hadFlags = parent != nullptr;
+    savedFlags = parent ? parent : "";
+    owner = true;
+    readFd = openReader(pipeFds[0]);
+    writeFd = pipeFds[1];
+    size = jobs;
+    if (readFd < 0) {
+        close();
+        return false;
+    }
+
+    string tokens(jobs - 1, '+');
+    if (write(writeFd, tokens.data(), tokens.size()) != (ssize_t)tokens.size()) {
+        close();
+        return false;
+    }
+
+    /** replace the pool of a parent make, if any, with ours */
+    vector<string> words;
+    string overrides, flags;
+    splitFlags(hadFlags ? savedFlags.c_str() : nullptr, words, overrides);
+    for (const string& word : words)
+        if (word.compare(0, 2, "-j") != 0 && word.compare(0, 12, "--jobserver-") != 0)
+            flags += word + " ";
+    flags += "-j" + to_string(jobs) + " --jobserver-auth="
+           + to_string(pipeFds[0]) + "," + to_string(pipeFds[1]) + overrides;
+    setenv("MAKEFLAGS", flags.c_str(), 1);
+    return true;
+}
+
+char Jobserver::acquire()
+{
+    for (;;) {
+        bool free = true;
+        if (implicit.compare_exchange_strong(free, false))
+            return 0;
+
+        char token;
+        ssize_t n = read(readFd, &token, 1);
+        if (n == 1)
+            return token;
+
+        /** the implicit slot may come back in the meantime, so don't wait on
+            the pool forever */
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            pollfd fd = { readFd, POLLIN, 0 };
+            poll(&fd, 1, 100);
+            continue;
+        }
+
+        /** the pool is gone (every writer closed it); carry on without it */
+        return 0;
+    }
+}
+
+void Jobserver::release(char token)
+{
+    if (!token) {
+        implicit = true;
+        return;
+    }
+    while (write(writeFd, &token, 1) < 0 && errno == EINTR)
+        ;
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef PIE_JOBSERVER_HPP
+#define PIE_JOBSERVER_HPP
+
+#include <atomic>
+#include <string>
+
+/** Jobserver shares one pool of job slots between pie and every make (or
+    pie) its tasks start, using the GNU make jobserver protocol.
+
+    The pool is a pipe (or a named fifo) holding one byte, a "token", per free
+    slot. Every process gets one implicit slot for free; to run a second job
+    at the same time it has to read a token from the pool first, and write it
+    back when the job is done. A recursive make that finds the pool in
+    MAKEFLAGS takes tokens from the same pool, so "pie --make -j 8" whose
+    recipes run "make" never has more than 8 jobs running in total.
+
+    MAKEFLAGS=" -j8 --jobserver-auth=3,4"         (pipe, fds 3 and 4)
+    MAKEFLAGS=" -j8 --jobserver-auth=fifo:/tmp/x" (named fifo, make >= 4.4)
+
+    On Windows make uses a named semaphore instead, which isn't supported: no
+    pool is ever joined or created there. */
+class Jobserver
+{
+public:
+    ~Jobserver();
+
+    /** join the pool of a parent make from MAKEFLAGS */
+    bool join();
+
+    /** whether MAKEFLAGS has a pool passed as file descriptors, which only
+        this process (not e.g. a daemon) can use */
+    static bool passedAsFds();
+
+    /** create a pool for "jobs" slots (the implicit one plus jobs-1 tokens)
+        and put it in MAKEFLAGS for the children, until it's destroyed */
+    bool create(unsigned int jobs);
+
+    bool active() const { return readFd >= 0; }
+
+    /** the -j of the pool from MAKEFLAGS, 0 if it doesn't say */
+    unsigned int jobs() const { return size; }
+
+    /** take a slot: the implicit one if it's free, otherwise a token from the
+        pool, waiting for one if there is none. Returns the token to give
+        back to release() (0 for the implicit slot) */
+    char acquire();
+    void release(char token);
+
+    /** RAII helper, holds a slot for the lifetime of a scope (nothing if
+        there is no pool) */
+    class Token
+    {
+    public:
+        explicit Token(Jobserver& js)
+            : js(js.active() ? &js : nullptr), token(this->js ? js.acquire() : 0) { }
+        ~Token() { if (js) js->release(token); }
+
+    private:
+        Jobserver* js;
+        char token;
+    };
+
+private:
+    void close();
+
+    int readFd = -1;   /** non-blocking, our own open file description */
+    int writeFd = -1;
+    int pipeFds[2] = { -1, -1 };  /** the pipe we created, children inherit it */
+    std::string fifo;  /** path of the fifo we joined or created */
+    bool owner = false;
+    bool hadFlags = false;  /** MAKEFLAGS before create() */
+    std::string savedFlags;
+    unsigned int size = 0;
+    std::atomic<bool> implicit{ true };
+};
+
+#endif
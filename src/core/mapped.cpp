@@ -0,0 +1,82 @@
+#include "mapped.hpp"
+
+#ifdef _WIN32
+#include <fstream>
+#include <sstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifdef _WIN32
+
+bool MappedFile::open(const string& path)
+{
+    close();
+    ifstream file(path, ios::binary);
+    if (!file)
+        return false;
+
+    stringstream ss;
+    ss << file.rdbuf();
+    buffer = ss.str();
+    ptr = buffer.data();
+    len = buffer.size();
+    return true;
+}
+
+void MappedFile::close()
+{
+    buffer.clear();
+    ptr = nullptr;
+    len = 0;
+}
+
+#else
+
+bool MappedFile::open(const string& path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    /** mmap() refuses a length of 0, an empty file is just an empty view */
+    len = st.st_size;
+    if (len) {
+        void* map = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            ::close(fd);
+            len = 0;
+            return false;
+        }
+        madvise(map, len, MADV_SEQUENTIAL);
+        ptr = static_cast<const char*>(map);
+    } else {
+        ptr = "";
+    }
+
+    /** the mapping stays valid after the descriptor is closed */
+    ::close(fd);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (ptr && len)
+        munmap(const_cast<char*>(ptr), len);
+    ptr = nullptr;
+    len = 0;
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef PIE_MAPPED_HPP
+#define PIE_MAPPED_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/** MappedFile maps a whole file read-only into memory (mmap on Unix), so it
+    can be looked at as one big array without copying it into a string. On
+    Windows the file is simply read into a buffer.
+
+    e.g.
+    MappedFile file;
+    if (file.open("Piefile"))
+        std::string_view text = file.view(); */
+class MappedFile
+{
+public:
+    MappedFile() { }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    /** returns false (and sets errno) if the file can't be opened or mapped */
+    bool open(const std::string& path);
+    void close();
+
+    const char* data() const { return ptr; }
+    std::size_t size() const { return len; }
+    std::string_view view() const { return std::string_view(ptr, len); }
+
+private:
+    const char* ptr = nullptr;
+    std::size_t len = 0;
+#ifdef _WIN32
+    std::string buffer;
+#endif
+};
+
+#endif
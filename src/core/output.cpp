@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+
+#include "output.hpp"
+
+using namespace std;
+
+/** one lock for the terminal, shared by every job */
+static mutex console;
+
+static void emit(Process::Stream stream, const string& text)
+{
+    FILE* f = stream == Process::ERR ? stderr : stdout;
+    fwrite(text.data(), 1, text.size(), f);
+}
+
+void JobOutput::write(Process::Stream stream, string_view text)
+{
+    if (text.empty())
+        return;
+
+    if (chunks.empty() || chunks.back().stream != stream)
+        chunks.push_back(Chunk{ stream, string() });
+    chunks.back().text.append(text);
+
+    if (live && text.find('\n') != string_view::npos)
+        flushLines();
+}
+
+Process::Sink JobOutput::sink()
+{
+    return [this](Process::Stream stream, const char* data, size_t size) {
+        write(stream, string_view(data, size));
+    };
+}
+
+void JobOutput::flushLines()
+{
+    lock_guard<mutex> guard(console);
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        Chunk& chunk = chunks[i];
+        bool last = i + 1 == chunks.size();
+
+        /** keep an unfinished line of the last chunk for later */
+        string::size_type end = last ? chunk.text.rfind('\n') : chunk.text.size() - 1;
+        if (end == string::npos)
+            break;
+
+        emit(chunk.stream, chunk.text.substr(0, end + 1));
+        chunk.text.erase(0, end + 1);
+    }
+
+    chunks.erase(remove_if(chunks.begin(), chunks.end(),
+                           [](const Chunk& c) { return c.text.empty(); }),
+                 chunks.end());
+
+    fflush(stdout);
+    fflush(stderr);
+}
+
+void JobOutput::flush()
+{
+    if (chunks.empty())
+        return;
+
+    lock_guard<mutex> guard(console);
+    for (Chunk& chunk : chunks)
+        emit(chunk.stream, chunk.text);
+    chunks.clear();
+
+    fflush(stdout);
+    fflush(stderr);
+}
@@ -0,0 +1,55 @@
+#ifndef PIE_OUTPUT_HPP
+#define PIE_OUTPUT_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "process.hpp"
+
+/** JobOutput collects everything printed while one target is processed: the
+    "@task" echo lines, the output of the task's child processes and errors.
+
+    With several jobs running at once, writing all of that to the terminal
+    as it arrives would interleave lines of different targets into garbage.
+    Instead each job keeps its own buffer, and flush() (called when the job
+    is done, or by the destructor) prints the whole thing in one go while
+    holding the console lock, so jobs appear one after another.
+
+    In live mode (a single job at a time, -j 1) there is nobody to interleave
+    with, so output is passed through as soon as a line is complete.
+
+    stdout and stderr are kept apart, and in the order they were written */
+class JobOutput
+{
+public:
+    explicit JobOutput(bool live = false): live(live) { }
+    JobOutput(const JobOutput&) = delete;
+    JobOutput& operator=(const JobOutput&) = delete;
+    ~JobOutput() { flush(); }
+
+    void write(Process::Stream stream, std::string_view text);
+    void out(std::string_view text) { write(Process::OUT, text); }
+    void err(std::string_view text) { write(Process::ERR, text); }
+
+    /** a sink for Process::wait() that writes into this job's output */
+    Process::Sink sink();
+
+    /** print everything buffered so far, atomically */
+    void flush();
+
+private:
+    struct Chunk {
+        Process::Stream stream;
+        std::string text;
+    };
+
+    /** in live mode, print the complete lines buffered so far */
+    void flushLines();
+
+    bool live;
+    std::vector<Chunk> chunks;
+};
+
+#endif
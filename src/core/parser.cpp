@@ -0,0 +1,138 @@
+#include <cstring>
+
+#include "parser.hpp"
+
+using namespace std;
+
+/** spaces are trimmed from both ends of every line; a '\r' left over from a
+    Windows line ending is dropped as well */
+static string_view trimLine(string_view line)
+{
+    if (!line.empty() && line.back() == '\r')
+        line.remove_suffix(1);
+
+    string_view::size_type begin = line.find_first_not_of(' ');
+    if (begin == string_view::npos)
+        return string_view();
+    return line.substr(begin, line.find_last_not_of(' ') - begin + 1);
+}
+
+static string_view trimName(string_view name)
+{
+    string_view::size_type begin = name.find_first_not_of(" \t");
+    if (begin == string_view::npos)
+        return string_view();
+    return name.substr(begin, name.find_last_not_of(" \t") - begin + 1);
+}
+
+/** if the task line is "depfile = <path>", put the path in depfile */
+static bool parseDepfileLine(string_view task, string_view& depfile)
+{
+    static const string_view key = "depfile";
+    if (task.substr(0, key.size()) != key)
+        return false;
+
+    string_view rest = task.substr(key.size());
+    string_view::size_type eq = rest.find_first_not_of(" \t");
+    if (eq == string_view::npos || rest[eq] != '=')
+        return false;
+
+    depfile = trimName(rest.substr(eq + 1));
+    return true;
+}
+
+/** "adjacent" refers to the tokens after the colon, these are dependencies...
+    i.e. other targets the current one depends on. We hop from token to token
+    and store each one, so a long list costs a single pass over it */
+static void parseAdjacent(string_view adj, Target& tgt)
+{
+    string_view::size_type pos = 0, end;
+    while ((pos = adj.find_first_not_of(" \t", pos)) != string_view::npos) {
+        end = adj.find_first_of(" \t", pos);
+        if (end == string_view::npos)
+            end = adj.size();
+        tgt.adjacent.emplace_back(adj.substr(pos, end - pos));
+        pos = end;
+    }
+}
+
+/** if the line is "NAME = value", put the two in name and value. The name
+    can't have spaces or tabs in it, and the '=' has to come before any
+    colon, so "a: b=c" is still a target */
+static bool parseVariableLine(string_view line, string_view& name,
+                              string_view& value)
+{
+    string_view::size_type eq = line.find_first_of("=:");
+    if (eq == string_view::npos || line[eq] != '=')
+        return false;
+
+    name = trimName(line.substr(0, eq));
+    value = trimName(line.substr(eq + 1));
+    return true;
+}
+
+bool parseTargets(string_view text, TargetMap& nodes, Variables& vars,
+                  ParseError& error)
+{
+    const char* p = text.data();
+    const char* end = p + text.size();
+    unsigned int lineNo = 0;
+    Target* current = nullptr;
+
+    while (p < end) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!eol)
+            eol = end;
+        string_view line = trimLine(string_view(p, eol - p));
+        p = eol + 1;
+        ++lineNo;
+
+        /** skip empty lines or lines with only spaces */
+        if (line.empty())
+            continue;
+
+        /** a line starting with a tab is a task of the current target */
+        if (line[0] == '\t' && current) {
+            string_view depfile;
+            if (parseDepfileLine(line.substr(1), depfile))
+                current->depfile.assign(depfile);
+            else
+                current->tasks.emplace_back(line.substr(1));
+            continue;
+        }
+
+        string_view var, value;
+        if (parseVariableLine(line, var, value)) {
+            if (var.empty() || var.find_first_of(" \t") != string_view::npos) {
+                error.line = lineNo;
+                error.msg = "bad variable name";
+                return false;
+            }
+            vars.define(string(var), string(value));
+            current = nullptr;
+            continue;
+        }
+
+        string_view::size_type pos = line.find(':');
+        string_view name = pos == string_view::npos
+                         ? string_view() : trimName(line.substr(0, pos));
+        if (name.empty()) {
+            error.line = lineNo;
+            error.msg = "no target";
+            return false;
+        }
+        /** Make's "NAME := value" would be a target NAME otherwise */
+        if (line.substr(pos + 1, 1) == "=") {
+            error.line = lineNo;
+            error.msg = "only NAME = value defines a variable";
+            return false;
+        }
+
+        /** a target named twice collects the dependencies and tasks of both */
+        string key(name);
+        current = &nodes.try_emplace(key, key).first->second;
+        parseAdjacent(line.substr(pos + 1), *current);
+    }
+
+    return true;
+}
@@ -0,0 +1,51 @@
+#ifndef PIE_PARSER_HPP
+#define PIE_PARSER_HPP
+
+#include <string>
+#include <string_view>
+
+#include "target.hpp"
+#include "variables.hpp"
+
+/** where and why parsing failed, line numbers start at 1 */
+struct ParseError
+{
+    unsigned int line = 0;
+    std::string msg;
+};
+
+/** build a map of Targets from the text of a Piefile. A line that 1) is not
+    part of a target's indented tasks block 2) is non-empty and 3) does not
+    have a colon is an ERROR! A line with a colon starts a new target, the
+    name before the colon is the target and the names after it are its
+    dependencies (Target::adjacent). The tab-indented lines below it are its
+    tasks, empty or space-only lines in between are skipped.
+
+    e.g.
+    myTarget: dep1 dep2
+        task1
+
+        task2
+
+    A "depfile = <path>" line in the tasks block is not a task, it tells us
+    where the tasks write their depfile (Target::depfile):
+
+    main.o: main.cpp
+        g++ -MMD -MF main.d -c main.cpp -o main.o
+        depfile = main.d
+
+    A line of the form "NAME = value" (with the '=' before any colon) is a
+    variable instead, it goes into vars (see Variables):
+
+    CXXFLAGS = -O2 -Wall
+
+    Make's "NAME := value" is an error rather than a target called NAME.
+
+    The text is walked ONCE from start to end with string_views pointing into
+    it (typically a MappedFile), nothing is copied until a name, dependency
+    or task is stored in its Target. That keeps Piefiles of hundreds of MB,
+    or targets with thousands of dependencies, linear to parse */
+bool parseTargets(std::string_view text, TargetMap& nodes, Variables& vars,
+                  ParseError& error);
+
+#endif
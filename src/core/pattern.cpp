@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#include "pattern.hpp"
+
+using namespace std;
+
+/** how deep rules may chain (%.o from %.cpp from %.y ...) */
+static const int MAX_CHAIN = 4;
+
+static bool isPattern(const string& name)
+{
+    return name.find('%') != string::npos;
+}
+
+/** the stem of name if it fits pattern */
+static bool match(const string& pattern, const string& name, string& stem)
+{
+    string::size_type pct = pattern.find('%');
+    string::size_type suffix = pattern.size() - pct - 1;
+    if (name.size() <= pct + suffix
+        || name.compare(0, pct, pattern, 0, pct) != 0
+        || name.compare(name.size() - suffix, suffix, pattern, pct + 1) != 0)
+        return false;
+
+    stem = name.substr(pct, name.size() - pct - suffix);
+    return true;
+}
+
+static string substitute(const string& pattern, const string& stem)
+{
+    string::size_type pct = pattern.find('%');
+    if (pct == string::npos)
+        return pattern;
+    return pattern.substr(0, pct) + stem + pattern.substr(pct + 1);
+}
+
+PatternRules::PatternRules(TargetMap& nodes)
+{
+    for (auto it = nodes.begin(); it != nodes.end(); ) {
+        if (isPattern(it->first)) {
+            rules.push_back(move(it->second));
+            it = nodes.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    /** the map has no order, sort so that ties are broken the same way
+        every time */
+    sort(rules.begin(), rules.end(),
+         [](const Target& a, const Target& b) { return a.name < b.name; });
+}
+
+/** the rule that can make name, nullptr if there is none */
+const Target* PatternRules::find(const TargetMap& nodes, const string& name,
+                                 string& stem, int depth) const
+{
+    const Target* best = nullptr;
+    string candidate, inner;
+    for (const Target& rule : rules) {
+        if (!match(rule.name, name, candidate)
+            || (best && candidate.size() >= stem.size()))
+            continue;
+
+        bool usable = true;
+        for (const string& adj : rule.adjacent) {
+            string prereq = substitute(adj, candidate);
+            error_code ec;
+            if (nodes.count(prereq) || filesystem::exists(prereq, ec))
+                continue;
+            if (depth < MAX_CHAIN && find(nodes, prereq, inner, depth + 1))
+                continue;
+            usable = false;
+            break;
+        }
+
+        if (usable) {
+            best = &rule;
+            stem = candidate;
+        }
+    }
+    return best;
+}
+
+Target PatternRules::make(const Target& rule, const string& name,
+                          const string& stem) const
+{
+    Target tgt(name);
+    for (const string& adj : rule.adjacent)
+        tgt.adjacent.push_back(substitute(adj, stem));
+    tgt.depfile = substitute(rule.depfile, stem);
+
+    string all;
+    for (const string& adj : tgt.adjacent)
+        all += (all.empty() ? "" : " ") + adj;
+
+    for (const string& task : rule.tasks) {
+        string out;
+        for (string::size_type i = 0; i < task.size(); ++i) {
+            char next = i + 1 < task.size() ? task[i + 1] : 0;
+            if (task[i] != '$' || !next || !strchr("@<*^", next)) {
+                out += task[i];
+                continue;
+            }
+            if (next == '@')
+                out += name;
+            else if (next == '<')
+                out += tgt.adjacent.empty() ? "" : tgt.adjacent[0];
+            else if (next == '*')
+                out += stem;
+            else
+                out += all;
+            ++i;
+        }
+        tgt.tasks.push_back(move(out));
+    }
+    return tgt;
+}
+
+size_t PatternRules::instantiate(TargetMap& nodes, const vector<string>& roots) const
+{
+    if (rules.empty())
+        return 0;
+
+    size_t added = 0;
+    StringSet seen;
+    vector<string> queue(roots.rbegin(), roots.rend());
+    while (!queue.empty()) {
+        string name = move(queue.back());
+        queue.pop_back();
+        if (!seen.insert(name).second)
+            continue;
+
+        auto it = nodes.find(name);
+        if (it == nodes.end()) {
+            string stem;
+            const Target* rule = find(nodes, name, stem, 0);
+            if (!rule)
+                continue;   /** a plain file */
+            it = nodes.emplace(name, make(*rule, name, stem)).first;
+            ++added;
+        }
+
+        for (const string& adj : it->second.adjacent)
+            if (!seen.count(adj))
+                queue.push_back(adj);
+    }
+    return added;
+}
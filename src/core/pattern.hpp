@@ -0,0 +1,55 @@
+#ifndef PIE_PATTERN_HPP
+#define PIE_PATTERN_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "target.hpp"
+
+/** Pattern rules are Piefile targets with a '%' in their name. Like Make's,
+    they describe how to build any file whose name fits the pattern:
+
+    %.o: %.cpp
+    	g++ -MMD -MF $*.d -c $< -o $@
+    	depfile = %.d
+
+    '%' matches any non-empty part of a name (the "stem", which may contain
+    slashes: src/util.o has the stem src/util) and stands for the same stem
+    in the prerequisites and the depfile. In the tasks, the automatic
+    variables are replaced instead ('%' is too common in commands):
+
+    $@  the target        $<  its first prerequisite
+    $*  the stem          $^  all of its prerequisites
+
+    Concrete targets are only made from a rule when something needs them: a
+    goal, or a dependency of a target that's being built, with no target of
+    its own. The rule is used if each of its prerequisites exists, is a
+    target, or can be made by a rule itself. If several rules fit, the one
+    leaving the shortest stem (the most specific one) wins. So a tree of
+    80k sources doesn't turn into 80k Targets unless a goal depends on all
+    of them. */
+class PatternRules
+{
+public:
+    /** move the pattern rules out of nodes */
+    explicit PatternRules(TargetMap& nodes);
+
+    bool empty() const { return rules.empty(); }
+
+    /** add a target to nodes for every name needed by roots (targets or
+        goals), and by the targets added, that a rule can make. Returns the
+        number of targets added */
+    std::size_t instantiate(TargetMap& nodes,
+                            const std::vector<std::string>& roots) const;
+
+private:
+    const Target* find(const TargetMap& nodes, const std::string& name,
+                       std::string& stem, int depth) const;
+    Target make(const Target& rule, const std::string& name,
+                const std::string& stem) const;
+
+    std::vector<Target> rules;
+};
+
+#endif
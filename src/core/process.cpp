@@ -0,0 +1,218 @@
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "process.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+using namespace std;
+
+/** characters that mean something to the shell, if a command contains any of
+    them we can't just split it on spaces and exec it ourselves */
+static const char* SHELL_CHARS = "|&;<>()$`\\\"'*?[]#~=%{}!\n";
+
+/** builtins only exist inside the shell, there is no program to exec */
+static const char* SHELL_BUILTINS[] = {
+    "cd", "export", "unset", "set", "exit", "exec", "eval", "source", ".",
+    "alias", "ulimit", "umask", "read", "wait", "trap", "shift", ":", "test",
+    "[", "true", "false", "type", "command"
+};
+
+bool Process::needsShell(const string& command)
+{
+    if (command.find_first_of(SHELL_CHARS) != string::npos)
+        return true;
+
+    string::size_type begin = command.find_first_not_of(" \t");
+    if (begin == string::npos)
+        return true;
+    string first = command.substr(begin, command.find_first_of(" \t", begin) - begin);
+    for (const char* builtin : SHELL_BUILTINS)
+        if (first == builtin)
+            return true;
+
+    return false;
+}
+
+#ifdef _WIN32
+
+/** there's no posix_spawn on Windows, let cmd.exe run the line and hand us
+    its (merged) output through _popen */
+bool Process::start(const string& command)
+{
+    cout.flush();
+    pipe = _popen((command + " 2>&1").c_str(), "r");
+    return pipe != nullptr;
+}
+
+int Process::wait(const Sink& sink)
+{
+    if (!pipe)
+        return 127;
+
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+        if (sink) sink(OUT, buffer, n);
+        else cout.write(buffer, n);
+    }
+    cout.flush();
+
+    int status = _pclose(pipe);
+    pipe = nullptr;
+    return status;
+}
+
+Process::~Process()
+{
+    if (pipe)
+        _pclose(pipe);
+}
+
+#else
+
+/** make a pipe whose ends are not inherited by children we spawn later, or a
+    second child would keep our read end from ever seeing EOF */
+static bool makePipe(int fds[2])
+{
+#ifdef __linux__
+    return pipe2(fds, O_CLOEXEC) == 0;
+#else
+    if (pipe(fds) != 0)
+        return false;
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+#endif
+}
+
+bool Process::start(const string& command)
+{
+    /** split the command into argv, or let the shell do it */
+    vector<string> words;
+    if (needsShell(command)) {
+        words = { "/bin/sh", "-c", command };
+    } else {
+        string::size_type pos = 0, end;
+        while ((pos = command.find_first_not_of(" \t", pos)) != string::npos) {
+            end = command.find_first_of(" \t", pos);
+            words.push_back(command.substr(pos, end - pos));
+            pos = end;
+        }
+    }
+
+    vector<char*> argv;
+    for (string& w : words)
+        argv.push_back(&w[0]);
+    argv.push_back(nullptr);
+
+    int outPipe[2], errPipe[2];
+    if (!makePipe(outPipe))
+        return false;
+    if (!makePipe(errPipe)) {
+        close(outPipe[0]); close(outPipe[1]);
+        return false;
+    }
+
+    /** dup2 clears close-on-exec on the new descriptors 1 and 2, so the child
+        keeps exactly those two ends */
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, outPipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, errPipe[1], STDERR_FILENO);
+
+    int rc = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+
+    close(outPipe[1]);
+    close(errPipe[1]);
+    out = outPipe[0];
+    err = errPipe[0];
+
+    if (rc != 0) {
+        close(out); close(err);
+        out = err = -1;
+        pid = -1;
+        errno = rc;
+        return false;
+    }
+    return true;
+}
+
+int Process::wait(const Sink& sink)
+{
+    if (pid < 0)
+        return 127;
+
+    /** drain both pipes until the child closed them */
+    char buffer[4096];
+    pollfd fds[2] = { { out, POLLIN, 0 }, { err, POLLIN, 0 } };
+    int open = 2;
+    while (open) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < 2; ++i) {
+            if (fds[i].fd < 0 || !fds[i].revents)
+                continue;
+            ssize_t n = read(fds[i].fd, buffer, sizeof(buffer));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0) {
+                close(fds[i].fd);
+                fds[i].fd = -1;
+                --open;
+                continue;
+            }
+
+            Stream stream = i ? ERR : OUT;
+            if (sink) {
+                sink(stream, buffer, n);
+            } else {
+                ostream& os = stream == ERR ? cerr : cout;
+                os.write(buffer, n);
+                os.flush();
+            }
+        }
+    }
+    out = err = -1;
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            pid = -1;
+            return 127;
+        }
+    }
+    pid = -1;
+
+    /** like Make, a command is successful if it exited with code 0 */
+    if (WIFEXITED(status))
+        return WEXITSTATUS(status);
+    if (WIFSIGNALED(status))
+        return 128 + WTERMSIG(status);
+    return 127;
+}
+
+Process::~Process()
+{
+    if (out >= 0) close(out);
+    if (err >= 0) close(err);
+    if (pid > 0) {
+        int status;
+        waitpid(pid, &status, 0);
+    }
+}
+
+#endif
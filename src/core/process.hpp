@@ -0,0 +1,69 @@
+#ifndef PIE_PROCESS_HPP
+#define PIE_PROCESS_HPP
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#else
+#include <stdio.h>
+#endif
+
+/** Process is one child started for a recipe line (see doTask()).
+
+    On Unix the child is launched with posix_spawn, which uses vfork+exec
+    under the hood instead of copying the whole parent like fork() does.
+    Commands that don't need a shell (no quotes, pipes, redirections,
+    variables, globs or shell builtins) are exec'ed directly, everything else
+    goes through /bin/sh -c like system() would.
+
+    The child's stdout and stderr are connected to pipes, so any number of
+    children can run at the same time; wait() streams their output to the
+    given sink until both pipes are closed and then reaps the child.
+
+    e.g.
+    Process proc;
+    if (proc.start("g++ -c main.cpp") && proc.wait() == 0)
+        ... success ... */
+class Process
+{
+public:
+    /** which of the child's streams a chunk of output came from */
+    enum Stream { OUT = 1, ERR = 2 };
+
+    /** receives output of the child as it arrives */
+    typedef std::function<void(Stream, const char*, std::size_t)> Sink;
+
+    Process() { }
+    Process(const Process&) = delete;
+    Process& operator=(const Process&) = delete;
+    ~Process();
+
+    /** launch the command, returns false (and sets errno) if it could not be
+        started */
+    bool start(const std::string& command);
+
+    /** stream the child's output into sink (by default our own stdout and
+        stderr) and wait for it to exit.
+
+        returns the exit code like a shell reports it: WEXITSTATUS() if the
+        child exited normally, 128 + the signal number if it was killed and
+        127 if the command could not be executed at all */
+    int wait(const Sink& sink = Sink());
+
+    /** whether the command has to be interpreted by /bin/sh */
+    static bool needsShell(const std::string& command);
+
+private:
+#ifdef _WIN32
+    FILE* pipe = nullptr;
+#else
+    pid_t pid = -1;
+    int out = -1;
+    int err = -1;
+#endif
+};
+
+#endif
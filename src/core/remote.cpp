@@ -0,0 +1,278 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+#include <thread>
+
+#include "remote.hpp"
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <csignal>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+using namespace std;
+
+#ifdef _WIN32
+
+RemotePool::RemotePool(const vector<string>& workers, unsigned int)
+    : workers(workers) { }
+RemotePool::~RemotePool() { }
+RemotePool::Result RemotePool::run(unsigned int, const string&,
+                                   const Process::Sink&, int&)
+{
+    return UNREACHED;
+}
+
+int serveWorker(const string&)
+{
+    cerr << "Error: --worker isn't supported on Windows\n";
+    return 1;
+}
+
+#else
+
+/** split "host:port", a lone port is on this machine */
+static void splitAddress(const string& address, string& host, string& port)
+{
+    string::size_type colon = address.rfind(':');
+    host = colon == string::npos ? "127.0.0.1" : address.substr(0, colon);
+    port = colon == string::npos ? address : address.substr(colon + 1);
+}
+
+/** a TCP socket connected to (or, if "bound", listening on) address */
+static int openSocket(const string& address, bool bound)
+{
+    string host, port;
+    splitAddress(address, host, port);
+
+    addrinfo hints = {}, *found = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = bound ? AI_PASSIVE : 0;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0)
+        return -1;
+
+    int fd = -1;
+    for (addrinfo* ai = found; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0)
+            continue;
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+        int on = 1;
+        bool ok;
+        if (bound) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            ok = bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 64) == 0;
+        } else {
+            ok = connect(fd, ai->ai_addr, ai->ai_addrlen) == 0;
+        }
+        if (!ok) {
+            close(fd);
+            fd = -1;
+            continue;
+        }
+        /** output comes in small pieces, don't hold them back */
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    freeaddrinfo(found);
+    return fd;
+}
+
+static bool readAll(int fd, void* data, size_t size)
+{
+    char* at = (char*)data;
+    while (size) {
+        ssize_t n = read(fd, at, size);
+        if (n <= 0)
+            return false;
+        at += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool sendAll(int fd, const void* data, size_t size)
+{
+    const char* at = (const char*)data;
+    while (size) {
+        ssize_t n = send(fd, at, size, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        at += n;
+        size -= n;
+    }
+    return true;
+}
+
+RemotePool::RemotePool(const vector<string>& workers, unsigned int slots)
+    : workers(workers), connections(slots ? slots : 1, -1)
+{
+    error_code ec;
+    cwd = filesystem::current_path(ec).string();
+}
+
+RemotePool::~RemotePool()
+{
+    for (int fd : connections)
+        if (fd >= 0)
+            close(fd);
+}
+
+/** an idle connection has nothing to read, unless the worker closed it */
+static bool closedByPeer(int fd)
+{
+    pollfd p = { fd, POLLIN, 0 };
+    return poll(&p, 1, 0) != 0;
+}
+
+RemotePool::Result RemotePool::run(unsigned int slot, const string& task,
+                                   const Process::Sink& sink, int& status)
+{
+    if (workers.empty() || slot >= connections.size())
+        return UNREACHED;
+
+    int& fd = connections[slot];
+    if (fd >= 0 && closedByPeer(fd)) {
+        close(fd);
+        fd = -1;
+    }
+    if (fd < 0)
+        fd = openSocket(workers[slot % workers.size()], false);
+    if (fd < 0)
+        return UNREACHED;
+
+    string request = cwd + '\0' + task;
+    uint32_t length = htonl(request.size());
+    if (!sendAll(fd, &length, sizeof(length))
+        || !sendAll(fd, request.data(), request.size())) {
+        close(fd);
+        fd = -1;
+        return UNREACHED;
+    }
+
+    /** from here on the worker may have started the task */
+    string chunk;
+    for (;;) {
+        uint8_t stream;
+        if (!readAll(fd, &stream, sizeof(stream)))
+            break;
+        if (!stream) {
+            uint32_t code;
+            if (!readAll(fd, &code, sizeof(code)))
+                break;
+            status = (int32_t)ntohl(code);
+            return DONE;
+        }
+
+        if (!readAll(fd, &length, sizeof(length)))
+            break;
+        length = ntohl(length);
+        chunk.resize(length);
+        if (!readAll(fd, &chunk[0], length))
+            break;
+        if (sink)
+            sink(stream == Process::ERR ? Process::ERR : Process::OUT,
+                 chunk.data(), chunk.size());
+    }
+
+    close(fd);
+    fd = -1;
+    return LOST;
+}
+
+/** single quotes for sh */
+static string quote(const string& text)
+{
+    string out = "'";
+    for (char c : text)
+        out += c == '\'' ? string("'\\''") : string(1, c);
+    return out + "'";
+}
+
+/** run the tasks coming in on one connection until it closes */
+static void serveConnection(int fd)
+{
+    uint32_t length;
+    bool connected = true;
+    while (connected && readAll(fd, &length, sizeof(length))) {
+        length = ntohl(length);
+        string request(length, '\0');
+        if (!readAll(fd, &request[0], length))
+            break;
+        string::size_type nul = request.find('\0');
+        if (nul == string::npos)
+            break;
+
+        /** run it where the build runs */
+        string line = "cd " + quote(request.substr(0, nul)) + " || exit 1\n"
+                    + request.substr(nul + 1);
+
+        auto frame = [&](uint8_t stream, const char* data, uint32_t size) {
+            uint32_t wire = htonl(size);
+            connected = connected && sendAll(fd, &stream, sizeof(stream))
+                     && sendAll(fd, &wire, sizeof(wire)) && sendAll(fd, data, size);
+        };
+
+        int32_t status;
+        Process proc;
+        if (!proc.start(line)) {
+            string msg = request.substr(nul + 1) + ": " + strerror(errno) + "\n";
+            frame(Process::ERR, msg.data(), msg.size());
+            status = 127;
+        } else {
+            status = proc.wait([&](Process::Stream stream, const char* data, size_t size) {
+                frame(stream, data, size);
+            });
+        }
+
+        uint8_t done = 0;
+        uint32_t code = htonl((uint32_t)status);
+        connected = connected && sendAll(fd, &done, sizeof(done))
+                 && sendAll(fd, &code, sizeof(code));
+    }
+    close(fd);
+}
+
+int serveWorker(const string& address)
+{
+    int fd = openSocket(address, true);
+    if (fd < 0) {
+        cerr << "Error: can't listen on [" << address << "]\n";
+        return 1;
+    }
+
+    /** a scheduler that went away must not take the worker with it. Unlike
+        SIG_IGN, a handler isn't passed on to the tasks we start */
+    signal(SIGPIPE, [](int) { });
+
+    cout << "[...Worker on " << address << "...]" << endl;
+    for (;;) {
+        int client = accept(fd, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            close(fd);
+            return 1;
+        }
+        fcntl(client, F_SETFD, FD_CLOEXEC);
+        thread(serveConnection, client).detach();
+    }
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef PIE_REMOTE_HPP
+#define PIE_REMOTE_HPP
+
+#include <string>
+#include <vector>
+
+#include "process.hpp"
+
+/** Remote execution: tasks can be run by "pie --worker" processes instead of
+    being started by the build itself, e.g. on other machines that see the
+    same files (an NFS share) or, for testing, on this one:
+
+    host1$ pie --worker 0.0.0.0:7300
+    host2$ pie --worker 0.0.0.0:7300
+    here$  pie --make -j 16 --workers host1:7300,host2:7300
+
+    Every executor slot (see Executor) keeps a TCP connection to one of the
+    workers, slot i to worker i % count, so -j decides how many tasks run at
+    once overall. A worker runs one task at a time per connection, in the
+    directory the build runs in, and streams its output back:
+
+    scheduler -> worker   uint32 length, directory '\0' command
+    worker -> scheduler   uint8 stream (1 stdout, 2 stderr), uint32 length,
+                          output... then uint8 0, int32 exit status
+
+    Numbers are in network byte order, so workers and schedulers may run on
+    different architectures.
+
+    A worker runs whatever it's sent, only let it listen where you trust
+    everybody (it listens on localhost unless given a host). Windows has no
+    workers. */
+class RemotePool
+{
+public:
+    /** workers are "host:port" (or just "port" on this machine), slots is
+        the number of executor slots */
+    RemotePool(const std::vector<std::string>& workers, unsigned int slots);
+    ~RemotePool();
+
+    RemotePool(const RemotePool&) = delete;
+    RemotePool& operator=(const RemotePool&) = delete;
+
+    bool empty() const { return workers.empty(); }
+
+    /** how run() went: DONE sets the exit status. UNREACHED means the task
+        never got to the worker, so it's safe to run it somewhere else. LOST
+        means the worker went away after it got the task, which may have
+        run (in part) already */
+    enum Result { DONE, UNREACHED, LOST };
+
+    /** run task on the worker of slot, its output goes to sink */
+    Result run(unsigned int slot, const std::string& task,
+               const Process::Sink& sink, int& status);
+
+private:
+    std::vector<std::string> workers;
+    std::vector<int> connections;  /** per slot, only used by that slot */
+    std::string cwd;
+};
+
+/** pie --worker: run the tasks sent to "address" until killed */
+int serveWorker(const std::string& address);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef PIE_TARGET_HPP
+#define PIE_TARGET_HPP
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+/** Target is a DAG node; it has a vertex ID (name), some edges (adjacent) and
+    data (tasks). If its tasks write a Make-style depfile (e.g. g++ -MMD),
+    depfile names it, so the dependencies found in there can be picked up
+    after the target ran (see DepsLog). */
+class Target
+{
+public:
+    Target(const std::string& name): name(name) { };
+    std::string name;
+    std::vector<std::string> adjacent;
+    std::vector<std::string> tasks;
+    std::string depfile;
+
+    friend std::ostream& operator<<(std::ostream& out, const Target& t);
+};
+
+/** to type less, create shorter aliases for these templated class names */
+typedef std::unordered_set<std::string> StringSet;
+typedef std::unordered_map<std::string, Target> TargetMap;
+
+#endif
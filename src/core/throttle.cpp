@@ -0,0 +1,84 @@
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "throttle.hpp"
+
+using namespace std;
+
+bool loadAverage(double& load)
+{
+    ifstream file("/proc/loadavg");
+    return bool(file >> load);
+}
+
+bool memoryUsed(uint64_t& mib)
+{
+    ifstream file("/proc/meminfo");
+    string line, key;
+    uint64_t total = 0, available = 0, kb;
+    bool haveTotal = false, haveAvailable = false;
+    while (getline(file, line) && !(haveTotal && haveAvailable)) {
+        istringstream fields(line);
+        if (!(fields >> key >> kb))
+            continue;
+        if (key == "MemTotal:") {
+            total = kb;
+            haveTotal = true;
+        } else if (key == "MemAvailable:") {
+            available = kb;
+            haveAvailable = true;
+        }
+    }
+    if (!haveTotal || !haveAvailable)
+        return false;
+
+    mib = (total - available) / 1024;
+    return true;
+}
+
+Throttle::Throttle(double maxLoad, uint64_t maxMemory)
+    : maxLoad(maxLoad), maxMemory(maxMemory)
+{
+}
+
+/** called with the lock held */
+bool Throttle::overBudget()
+{
+    if (maxLoad > 0) {
+        auto now = Clock::now();
+        while (!started.empty() && now - started.front() > chrono::seconds(1))
+            started.pop_front();
+
+        double load;
+        if (loadAverage(load) && load + started.size() >= maxLoad)
+            return true;
+    }
+
+    uint64_t used;
+    if (maxMemory > 0 && memoryUsed(used) && used > maxMemory)
+        return true;
+
+    return false;
+}
+
+/** the load changes without anyone telling us, so look again every now and
+    then besides whenever a task finishes */
+void Throttle::acquire()
+{
+    unique_lock<mutex> guard(lock);
+    while (running && overBudget())
+        wake.wait_for(guard, chrono::milliseconds(250));
+
+    ++running;
+    started.push_back(Clock::now());
+}
+
+void Throttle::release()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        --running;
+    }
+    wake.notify_all();
+}
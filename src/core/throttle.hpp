@@ -0,0 +1,73 @@
+#ifndef PIE_THROTTLE_HPP
+#define PIE_THROTTLE_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+/** Throttle holds back new tasks while the machine is busy, so -j can be set
+    for an idle machine without overloading a shared one.
+
+    Every task run on this machine takes a slot; taking one waits while
+    the load average is at or above "maxLoad", or while more than
+    "maxMemory" MiB of memory are in use. Since the load average only moves
+    slowly, tasks started in the last second count towards it (like Make's
+    -l). A slot is always granted when nothing else is running, otherwise a
+    machine that's busy with something else would stop the build for good.
+    So the number of tasks running goes down while the machine is busy and
+    back up to -j when it isn't.
+
+    pie --make -j 16 --max-load 12 --max-memory 28000
+
+    The numbers come from /proc/loadavg and /proc/meminfo; where those don't
+    exist (e.g. Windows or macOS) nothing is throttled. */
+class Throttle
+{
+public:
+    /** 0 disables the limit */
+    Throttle(double maxLoad, uint64_t maxMemory);
+
+    bool enabled() const { return maxLoad > 0 || maxMemory > 0; }
+
+    /** wait until a task may start, then count it as running */
+    void acquire();
+    void release();
+
+    /** RAII helper, holds a slot for the lifetime of a scope */
+    class Slot
+    {
+    public:
+        explicit Slot(Throttle& throttle)
+            : throttle(throttle.enabled() ? &throttle : nullptr)
+        { if (this->throttle) this->throttle->acquire(); }
+        ~Slot() { if (throttle) throttle->release(); }
+
+    private:
+        Throttle* throttle;
+    };
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    bool overBudget();
+
+    double maxLoad;
+    uint64_t maxMemory;
+
+    std::size_t running = 0;
+    std::deque<Clock::time_point> started;  /** in the last second */
+
+    std::mutex lock;
+    std::condition_variable wake;
+};
+
+/** 1 minute load average from /proc/loadavg */
+bool loadAverage(double& load);
+
+/** memory in use (total minus available) in MiB from /proc/meminfo */
+bool memoryUsed(uint64_t& mib);
+
+#endif
@@ -0,0 +1,38 @@
+#include <system_error>
+
+#include "timestamp.hpp"
+
+using namespace std;
+
+bool fileTime(const string& path, TimeStamp& stamp)
+{
+    /** the error_code overloads don't throw, a missing file is not an error
+        here, it just means the target has to be made */
+    error_code ec;
+    stamp = filesystem::last_write_time(path, ec);
+    return !ec;
+}
+
+bool isStale(const Target& tgt, const vector<string>& implicit)
+{
+    TimeStamp self;
+    if (!fileTime(tgt.name, self))
+        return true;
+
+    /** a phony dependency has no file either, so it's caught as missing */
+    for (const string& adj : tgt.adjacent) {
+        TimeStamp dep;
+        if (!fileTime(adj, dep))
+            return true;
+        if (dep > self)
+            return true;
+    }
+
+    for (const string& path : implicit) {
+        TimeStamp dep;
+        if (!fileTime(path, dep) || dep > self)
+            return true;
+    }
+
+    return false;
+}
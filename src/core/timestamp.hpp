@@ -0,0 +1,30 @@
+#ifndef PIE_TIMESTAMP_HPP
+#define PIE_TIMESTAMP_HPP
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "target.hpp"
+
+typedef std::filesystem::file_time_type TimeStamp;
+
+/** put the modification time of path into stamp, returns false if there is
+    no such file */
+bool fileTime(const std::string& path, TimeStamp& stamp);
+
+/** Make-style staleness check, a target has to run if
+
+    1) there is no file with its name (it's "phony", like all or clean)
+    2) one of its dependencies is a phony target, which always runs
+    3) one of its dependencies is missing or newer than the target
+    4) one of its implicit dependencies (found in its depfile during the
+       last build, see DepsLog) is missing or newer than the target
+
+    otherwise the target file is up to date and its tasks can be skipped.
+    This has to be asked AFTER the dependencies were processed, since running
+    them is what updates their timestamps */
+bool isStale(const Target& tgt,
+             const std::vector<std::string>& implicit = {});
+
+#endif
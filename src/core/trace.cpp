@@ -0,0 +1,89 @@
+#include <cstdio>
+#include <fstream>
+
+#include "trace.hpp"
+
+using namespace std;
+
+/** quote a string for JSON */
+static string quoted(const string& str)
+{
+    string out = "\"";
+    for (char c : str) {
+        switch (c) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\t': out += "\\t"; break;
+        case '\r': out += "\\r"; break;
+        default:
+            if ((unsigned char)c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            } else {
+                out += c;
+            }
+        }
+    }
+    return out + "\"";
+}
+
+Trace::Trace(): epoch(chrono::steady_clock::now()) { }
+
+Trace::Micros Trace::now() const
+{
+    auto elapsed = chrono::steady_clock::now() - epoch;
+    return chrono::duration_cast<chrono::microseconds>(elapsed).count();
+}
+
+void Trace::span(const string& name, const char* category, unsigned int track,
+                 Micros start, Micros end, const string& args)
+{
+    string event = "{\"name\": " + quoted(name)
+                 + ", \"cat\": \"" + category + "\", \"ph\": \"X\""
+                 + ", \"ts\": " + to_string(start)
+                 + ", \"dur\": " + to_string(end - start)
+                 + ", \"pid\": 1, \"tid\": " + to_string(track);
+    if (!args.empty())
+        event += ", \"args\": {" + args + "}";
+    event += "}";
+
+    lock_guard<mutex> guard(lock);
+    events.push_back(move(event));
+}
+
+void Trace::counter(const char* name, Micros ts, uint64_t value)
+{
+    string event = string("{\"name\": \"") + name + "\", \"ph\": \"C\""
+                 + ", \"ts\": " + to_string(ts)
+                 + ", \"pid\": 1, \"args\": {\"" + name + "\": "
+                 + to_string(value) + "}}";
+
+    lock_guard<mutex> guard(lock);
+    events.push_back(move(event));
+}
+
+void Trace::track(unsigned int track, const string& name)
+{
+    string event = "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1"
+                   ", \"tid\": " + to_string(track)
+                 + ", \"args\": {\"name\": " + quoted(name) + "}}";
+
+    lock_guard<mutex> guard(lock);
+    events.push_back(move(event));
+}
+
+bool Trace::save(const string& path)
+{
+    ofstream out(path, ios::trunc);
+    if (!out)
+        return false;
+
+    lock_guard<mutex> guard(lock);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    for (size_t i = 0; i < events.size(); ++i)
+        out << events[i] << (i + 1 < events.size() ? ",\n" : "\n");
+    out << "]}\n";
+    return bool(out);
+}
@@ -0,0 +1,68 @@
+#ifndef PIE_TRACE_HPP
+#define PIE_TRACE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/** Trace records what happened during a build as Chrome trace events, the
+    JSON format understood by chrome://tracing and ui.perfetto.dev.
+
+    Each worker slot of the executor is one track (a "thread" in the JSON),
+    every target is a span on the track of the worker that ran it and its
+    tasks are nested spans below it. A counter track shows how many targets
+    were waiting in the ready queue, which makes serialization bottlenecks
+    (long stretches with one busy worker and an empty queue) easy to spot.
+
+    pie --make -j 8 --trace build.json */
+class Trace
+{
+public:
+    typedef uint64_t Micros;
+
+    Trace();
+
+    /** microseconds since the trace started */
+    Micros now() const;
+
+    /** a finished span [start, end) on a worker's track, "args" is an
+        optional JSON object body, e.g. "\"wait_us\": 12" (thread safe) */
+    void span(const std::string& name, const char* category, unsigned int track,
+              Micros start, Micros end, const std::string& args = "");
+
+    /** a sample of a counter track (thread safe) */
+    void counter(const char* name, Micros ts, uint64_t value);
+
+    /** name the track of a worker slot */
+    void track(unsigned int track, const std::string& name);
+
+    /** write the JSON file */
+    bool save(const std::string& path);
+
+    /** RAII helper, measures the lifetime of a scope as one span */
+    class Span
+    {
+    public:
+        Span(Trace* trace, const std::string& name, const char* category,
+             unsigned int track)
+            : trace(trace), name(name), category(category), track(track),
+              start(trace ? trace->now() : 0) { }
+        ~Span() { if (trace) trace->span(name, category, track, start, trace->now()); }
+
+    private:
+        Trace* trace;
+        std::string name;
+        const char* category;
+        unsigned int track;
+        Micros start;
+    };
+
+private:
+    std::chrono::steady_clock::time_point epoch;
+    std::mutex lock;
+    std::vector<std::string> events;
+};
+
+#endif
@@ -0,0 +1,89 @@
+#include "variables.hpp"
+
+using namespace std;
+
+void Variables::define(const string& name, string value)
+{
+    lock_guard<mutex> guard(lock);
+    values[name] = move(value);
+    expanded.clear();
+}
+
+bool Variables::expand(string_view text, string& out, string& cycle)
+{
+    /** most tasks don't use variables at all */
+    if (values.empty() || text.find("$(") == string_view::npos) {
+        out.assign(text);
+        return true;
+    }
+
+    out.clear();
+    out.reserve(text.size());
+    lock_guard<mutex> guard(lock);
+    return expandInto(text, out, cycle);
+}
+
+/** the ')' matching the '(' just before from, npos if there is none */
+static string_view::size_type closing(string_view text, string_view::size_type from)
+{
+    unsigned int depth = 1;
+    for (; from < text.size(); ++from) {
+        if (text[from] == '(')
+            ++depth;
+        else if (text[from] == ')' && --depth == 0)
+            return from;
+    }
+    return string_view::npos;
+}
+
+/** called with the lock held */
+bool Variables::expandInto(string_view text, string& out, string& cycle)
+{
+    string_view::size_type pos = 0, ref;
+    while ((ref = text.find("$(", pos)) != string_view::npos) {
+        string_view::size_type close = closing(text, ref + 2);
+        const string* val = nullptr;
+        if (close != string_view::npos
+            && !value(string(text.substr(ref + 2, close - ref - 2)), val, cycle))
+            return false;
+
+        /** not a variable: keep the "$(" and look for some inside it */
+        if (!val) {
+            out.append(text.substr(pos, ref + 2 - pos));
+            pos = ref + 2;
+            continue;
+        }
+        out.append(text.substr(pos, ref - pos));
+        out += *val;
+        pos = close + 1;
+    }
+    out.append(text.substr(pos));
+    return true;
+}
+
+/** the expansion of name goes to val, nullptr if it isn't defined. False
+    if it refers back to itself; called with the lock held */
+bool Variables::value(const string& name, const string*& val, string& cycle)
+{
+    auto done = expanded.find(name);
+    if (done != expanded.end()) {
+        val = &done->second;
+        return true;
+    }
+
+    auto raw = values.find(name);
+    if (raw == values.end())
+        return true;
+    if (!expanding.insert(name).second) {
+        cycle = name;
+        return false;
+    }
+
+    /** a cycle leaves nothing behind, it's only partly expanded */
+    string out;
+    bool ok = expandInto(raw->second, out, cycle);
+    expanding.erase(name);
+    if (ok)
+        val = &(expanded[name] = move(out));
+    return ok;
+}
@@ -0,0 +1,62 @@
+#ifndef PIE_VARIABLES_HPP
+#define PIE_VARIABLES_HPP
+
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+/** Variables are the "NAME = value" lines of a Piefile, referenced as
+    $(NAME) in tasks (and in the values of other variables):
+
+    CXXFLAGS = -std=c++2b -O2 -Wall
+    CXX = g++ $(CXXFLAGS)
+
+    main.o: main.cpp
+    	$(CXX) -c main.cpp -o main.o
+
+    Values are stored as written and only expanded when a task that uses
+    them is about to run, so a Piefile with thousands of targets doesn't
+    hold thousands of copies of the same flags. The expansion of each
+    variable is kept, since it can't change once the Piefile is parsed:
+    $(CXX) is built once no matter how many tasks use it. As values are
+    expanded late, a variable can be used before the line defining it, and
+    defining it again replaces the old value everywhere.
+
+    $(...) with a name that isn't defined is left alone, it's most likely
+    the shell's command substitution ("echo $(date)"), though variables
+    inside it are still expanded ("$(dirname $(OUT))"). A variable whose
+    value refers back to itself is an error. Only "=" defines variables,
+    there is no ":=" or "+=". */
+class Variables
+{
+public:
+    /** define (or redefine) name */
+    void define(const std::string& name, std::string value);
+
+    bool empty() const { return values.empty(); }
+
+    /** the definitions as written */
+    const std::unordered_map<std::string, std::string>& definitions() const
+    {
+        return values;
+    }
+
+    /** put text with every $(NAME) of a defined NAME replaced by its value
+        in out. False if a variable refers back to itself, its name is put
+        in cycle then (thread safe) */
+    bool expand(std::string_view text, std::string& out, std::string& cycle);
+
+private:
+    bool expandInto(std::string_view text, std::string& out, std::string& cycle);
+    bool value(const std::string& name, const std::string*& val,
+               std::string& cycle);
+
+    std::unordered_map<std::string, std::string> values;
+    std::unordered_map<std::string, std::string> expanded;
+    std::unordered_set<std::string> expanding;  /** to catch cycles */
+    std::mutex lock;
+};
+
+#endif
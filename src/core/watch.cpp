@@ -0,0 +1,97 @@
+#include "watch.hpp"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/** how long it has to be quiet before a batch of changes is handed out */
+static const int SETTLE_MS = 100;
+
+#ifndef __linux__
+
+Watcher::Watcher() { }
+Watcher::~Watcher() { }
+bool Watcher::add(const string&) { return false; }
+bool Watcher::wait(vector<string>&, int) { return false; }
+
+#else
+
+Watcher::Watcher()
+{
+    fd = inotify_init1(IN_CLOEXEC);
+}
+
+Watcher::~Watcher()
+{
+    if (fd >= 0)
+        close(fd);
+}
+
+bool Watcher::add(const string& path)
+{
+    if (fd < 0 || path.empty())
+        return false;
+
+    string::size_type slash = path.rfind('/');
+    string dir = slash == string::npos ? "" : path.substr(0, slash + 1);
+    if (!watches.count(dir)) {
+        int wd = inotify_add_watch(fd, dir.empty() ? "." : dir.c_str(),
+                                   IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE
+                                   | IN_DELETE | IN_MOVED_FROM | IN_ATTRIB);
+        if (wd < 0)
+            return false;
+        watches[dir] = wd;
+        dirs[wd] = dir;
+    }
+
+    files.insert(path);
+    return true;
+}
+
+bool Watcher::wait(vector<string>& changed, int timeout)
+{
+    changed.clear();
+    StringSet seen;
+    alignas(inotify_event) char buf[64 * 1024];
+
+    for (;;) {
+        /** until the first change, then only until it settles */
+        pollfd p = { fd, POLLIN, 0 };
+        int ready = poll(&p, 1, seen.empty() ? timeout : SETTLE_MS);
+        if (ready < 0)
+            return false;
+        if (!ready)
+            break;
+
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n <= 0)
+            return false;
+
+        for (char* at = buf; at < buf + n; ) {
+            inotify_event* event = (inotify_event*)at;
+            at += sizeof(inotify_event) + event->len;
+
+            /** events were lost, so anything could have changed */
+            if (event->mask & IN_Q_OVERFLOW) {
+                seen.insert(files.begin(), files.end());
+                continue;
+            }
+
+            auto dir = dirs.find(event->wd);
+            if (dir == dirs.end() || !event->len)
+                continue;
+            string path = dir->second + event->name;
+            if (files.count(path))
+                seen.insert(path);
+        }
+    }
+
+    changed.assign(seen.begin(), seen.end());
+    return true;
+}
+
+#endif
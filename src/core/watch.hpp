@@ -0,0 +1,48 @@
+#ifndef PIE_WATCH_HPP
+#define PIE_WATCH_HPP
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "target.hpp"
+
+/** Watcher tells us which files changed, using inotify.
+
+    Files are watched through their directory, since many editors save by
+    writing a new file and renaming it over the old one, which a watch on
+    the file itself wouldn't survive. Events for other files in the same
+    directory are ignored. After the first change, wait() keeps collecting
+    until nothing happened for a moment, so saving a bunch of files (or a
+    git checkout) turns into one rebuild.
+
+    A directory that doesn't exist yet can't be watched, and inotify only
+    exists on Linux: elsewhere nothing can be watched at all. */
+class Watcher
+{
+public:
+    Watcher();
+    ~Watcher();
+
+    Watcher(const Watcher&) = delete;
+    Watcher& operator=(const Watcher&) = delete;
+
+    /** whether inotify is available */
+    bool ok() const { return fd >= 0; }
+
+    /** start watching the file at path (relative to the current directory) */
+    bool add(const std::string& path);
+
+    /** block until watched files change, then return their paths in
+        "changed". With a timeout (in ms), "changed" is empty if nothing
+        changed in that time. Returns false if waiting failed */
+    bool wait(std::vector<std::string>& changed, int timeout = -1);
+
+private:
+    int fd = -1;
+    std::unordered_map<int, std::string> dirs;     /** watch -> "dir/" */
+    std::unordered_map<std::string, int> watches;  /** "dir/" -> watch */
+    StringSet files;
+};
+
+#endif
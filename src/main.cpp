@@ -1,8 +1,13 @@
 /** C++ std library */
+#include <algorithm>
+#include <chrono>
+#include <csignal>
 #include <ctime>
 #include <fstream>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 #include <fstream>
 #include <iostream>
@@ -15,8 +20,10 @@
 
 
 /** C std library and Unix headers (mainly used in function doTask()) */
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef _WIN32
 #include "unistd.h"
@@ -32,6 +39,27 @@
 
 #include "script/carescript-api.hpp"
 
+#include "core/target.hpp"
+#include "core/mapped.hpp"
+#include "core/parser.hpp"
+#include "core/graph.hpp"
+#include "core/executor.hpp"
+#include "core/buildlog.hpp"
+#include "core/depfile.hpp"
+#include "core/process.hpp"
+#include "core/output.hpp"
+#include "core/timestamp.hpp"
+#include "core/cache.hpp"
+#include "core/graphdb.hpp"
+#include "core/trace.hpp"
+#include "core/jobserver.hpp"
+#include "core/throttle.hpp"
+#include "core/watch.hpp"
+#include "core/daemon.hpp"
+#include "core/variables.hpp"
+#include "core/pattern.hpp"
+#include "core/remote.hpp"
+
 using namespace std;
 
 using std::endl;
@@ -45,25 +73,50 @@ using std::ifstream; /** class representing a file to read */
 using std::unordered_map; /** C++'s hash table */
 using std::unordered_set; /** C++'s hash set */
 
-void read_pieScript() {
-  std::clock_t c_start = std::clock();  // Track Time Taken
-        std::string r;
-        std::ifstream ifile("build.pie");
-        while(ifile.good()) r += ifile.get();
-        if(r != "") r.pop_back();
-
-        // creates a new interpreter instance
-        carescript::Interpreter interpreter;
+/** what pie --daemon keeps of build.pie between runs: its labels stay
+    lexed and compiled (in the interpreter) until the file changes or a run
+    changed the interpreter's builtins (bake) */
+struct ScriptCache
+{
+    Watcher watcher;
+    bool loaded = false;
+    std::size_t version = 0;  /** registry_version before build.pie had a say */
+};
 
-        // save the current state as id 0
-        interpreter.save(0);
+/** runs build.pie with "interpreter", starting from its state 0 (saved right
+    after it was created); pie --daemon keeps one interpreter around for all
+    its clients instead of building a new one every time, and passes "cache".
+    Returns the status build.pie exit()ed with (0 if it didn't), only a
+    hosted interpreter (the daemon's) gets back here after exit() */
+int runPieScript(carescript::Interpreter& interpreter, ScriptCache* cache) {
+  std::clock_t c_start = std::clock();  // Track Time Taken
+        interpreter.exited = false;
 
         // This code executes when an error occurs
         interpreter.on_error([](carescript::Interpreter &interp)
                              { std::cout << interp.error() << "\n"; });
 
-        // pre processes the code
-        interpreter.pre_process(r);
+        std::vector<std::string> changed;
+        bool current = cache && cache->loaded && cache->watcher.ok()
+                    && cache->watcher.wait(changed, 0) && changed.empty();
+        if (current) {
+          interpreter.settings.error_msg = "";
+        } else {
+          std::string r;
+          std::ifstream ifile("build.pie");
+          while(ifile.good()) r += ifile.get();
+          if(r != "") r.pop_back();
+
+          if (cache) {
+            cache->watcher.add("build.pie");
+            cache->version = interpreter.registry_version;
+          }
+
+          // pre processes the code
+          interpreter.pre_process(r);
+          if (cache)
+            cache->loaded = interpreter.settings.error_msg.empty();
+        }
 
         // runs the "main" label
         interpreter.run();
@@ -73,31 +126,42 @@ void read_pieScript() {
         // // runs the label "label_with_return" and unwraps the return value
         // carescript::ScriptVariable value = interpreter.run("label_with_return").get_value();
 
-        interpreter.load(0); // loads the saved state with id 0
+        // loads the saved state with id 0, if the script changed it: that
+        // bumps registry_version, so all of it is compiled again
+        if (!cache || interpreter.registry_version != cache->version) {
+          interpreter.load(0);
+          if (cache)
+            cache->loaded = false;
+        }
+
+        // load() doesn't cover what the script itself left behind
+        interpreter.settings.variables.clear();
+        interpreter.settings.constants.clear();
+        interpreter.settings.storage.clear();
+        interpreter.settings.exit = false;
+        interpreter.settings.line = 0;
+        interpreter.settings.ignore_endifs = 0;
+        interpreter.settings.should_run = {};
+        interpreter.settings.label = {};
+        int status = interpreter.exited ? interpreter.exit_status : 0;
         std::clock_t c_end = std::clock();
 
         double time_elapsed_ms = 1000.0 * (c_end - c_start) / CLOCKS_PER_SEC; // Calulate how much time taken
         std::cout << "CPU time used: " << time_elapsed_ms << " ms\n";
+        return status;
 }
 
+void read_pieScript() {
+        // creates a new interpreter instance
+        carescript::Interpreter interpreter;
 
+        // save the current state as id 0
+        interpreter.save(0);
 
-/** Target is a DAG node; it has a vertex ID (name), some edges (adjacent) and
-    data (tasks). */
-class Target
-{
-public:
-    Target(const string& name): name(name) { };
-    string name;
-    vector<string> adjacent;
-    vector<string> tasks;
+        runPieScript(interpreter, nullptr);
+}
 
-    friend ostream& operator<<(ostream& out, const Target& t);
-};
 
-/** to type less, create shorter aliases for these templated class names */
-typedef unordered_set<string> StringSet;
-typedef unordered_map<string, Target> TargetMap;
 
 /** overloaded output operator prints a vector of strings. Note that
     std::ostream is the TYPE of the cout object! In fact, defining this
@@ -122,284 +186,311 @@ ostream& operator<<(ostream& out, const Target& t) {
   return out;
 }
 
-/** return a COPY of the string with spaces trimmed from the left and right */
-string trimmed(const string& str, const string& rem=" ")
-{
-    /** C++ containers each have a <container>::size_type, which is a nested
-        numeric type big enough to describe the container's size (think of
-        string::size_type as an int)
-
-        This trim function 1) finds the FIRST occurence (integer position in
-        the string) of a char NOT in rem (string containing the char's we'd
-        like to trim off) then 2) finds the LAST occurence of a chat NOT in rem
-        3) the substring [FIRST, LAST] is what we return
-
-        @EXTRA:
-        https://en.cppreference.com/w/cpp/string/basic_string/find_first_not_of
-        https://en.cppreference.com/w/cpp/string/basic_string/find_first_not_of
-        for the string function docs */
-    string::size_type begin = str.find_first_not_of(rem);
-
-    /** No characters besides rem exists, return empty
-        Note string::npos is a constant which indicates "couldn't be found" */
-    if (begin == string::npos)
-        return "";
-
-    /** take the substring from FIRST occurence to LAST occurence of characters
-        which are NOT in rem, as discussed above */
-    return str.substr(begin, str.find_last_not_of(rem) - begin + 1);
-}
-
-/** read each line of a file and put its trimmed lines into a vector */
-bool readFile(const string& path, vector<string>& lines)
-{
-    ifstream file(path);
-    if (!file)
-        return false;
-
-    string line;
-    while (getline(file, line))
-        lines.push_back(trimmed(line));
-
-    /** return whether read succeded, let destructor close the file (RAII)
-
-        @EXTRA: There are 2 ways to close a file; either explicitly by calling
-        file.close() or implcitly via the destructor. Usually in C++ just let
-        the destructor do it. See these links for some interesting discussion.
-
-        (Specifically, Martin York's answer) https://stackoverflow.com/questions/748014/do-i-need-to-manually-close-an-ifstream
-        (Again, Martin York's answer) https://codereview.stackexchange.com/questions/540/open-write-and-close-a-file
-        https://stackoverflow.com/questions/16608783/handling-c-read-only-file-close-errors
-        */
-    return !file.bad();
-}
-
 /** print an error and line number */
 void lineError(unsigned int line, const string& msg) {
   cerr << "Error: " << msg << " [line " << line << "]\n";
 }
 
-/** print an error for a target */
-void targetError(const string& target) {
-  cerr << "Error: processing target [" << target << "]\n";
+/** print an error for a target (into the output of its job) */
+void targetError(JobOutput& out, const string& target) {
+  out.err("Error: processing target [" + target + "]\n");
 }
 
 /** print an error for a task */
-void taskError(const string& task) {
-  cerr << "Error: processing task [" << task << "]\n";
+void taskError(JobOutput& out, const string& task) {
+  out.err("Error: processing task [" + task + "]\n");
 }
 
-/** "adjacent" refers to tokens after the colon in the Cakefile, these are
-    dependencies... i.e. other targets the current one depends on. All we're
-    doing here is 1) taking the line after the colon 2) splitting that line
-    into tokens based on spaces (C++ has no std::split() so we make our own)
-    and inserting each token (i.e. the string name of a target that the current
-    target depends on) and 3) insert each token into the target's adjacent
-    vector
-
-    Therefore, the adjacent vector contains the NAMES of the targets that the
-    current one depends on, i.e. the NEIGHBOURS in the DEPENDENCY DAG
-
-    e.g.
-    myTarget: dep1 dep2
-        task1
-        task2
-
-    Here, we would add tokens dep1 and dep2 to Target::adjacent */
-void parseAdjacent(string adj, Target& tgt) {
-  string::size_type pos;
-
-  /** while there are still spaces */
-  while ((pos = adj.find(" ")) != string::npos) {
-    /** take the string from index 0 to the first space */
-    string token = adj.substr(0, pos);
-
-    /** erase it AND the space */
-    adj.erase(0, pos + 1);
-
-    /** if the token extracted is non-empty, add to the adjacency vector */
-    if (token.size()) tgt.adjacent.push_back(token);
-  }
-
-  /** don't forget the last token! */
-  if (adj.size()) tgt.adjacent.push_back(adj);
+/** print the targets along a dependency cycle, e.g. [a -> b -> a] */
+void cycleError(const BuildGraph& graph, const vector<BuildGraph::Id>& cycle) {
+  cerr << "Error: dependency cycle [";
+  for (size_t i = 0; i < cycle.size(); ++i)
+    cerr << (i ? " -> " : "") << graph.name(cycle[i]);
+  cerr << "]\n";
 }
 
-/** a task is a command listed with a tab (see Cakefile)... all we do here is
-    1) take non-empty 2) strings which start with a tab and 3) insert them
-    into the target's tasks vector
-    
-    returns whether the current target is fully parsed or not
-
-    e.g.
-    myTarget: dep1 dep2
-        task1
-
-        task2
-        task3
-
-    Here, we parse the whole indented block (skipping empty/space-only lines),
-    adding task1, task2 and task3 to Target::tasks returning false at task3 */
-bool parseTask(const string& t, vector<string>& tasks)
+/** topological sort: every target ends up in "order" after all of its
+    adjacent targets (dependencies!!)... this makes sense since we can't
+    finish the current target until those dependencies are done first.
+
+    BuildGraph::sort does the work with Kahn's algorithm: start with the
+    targets that depend on nothing, and every time a target is placed, the
+    targets waiting on it lose one dependency; once they have none left they
+    are placed too. If some targets never get placed, they wait on each
+    other, i.e. the Piefile has a cycle, which we report.
+
+    Dependencies that aren't targets are plain files (sources), they have
+    nothing to run so they're left out of the order. roots empty means sort
+    every target */
+bool sortTargets(const BuildGraph& graph, const vector<BuildGraph::Id>& roots,
+                 vector<BuildGraph::Id>& order)
 {
-    /** skip empty lines or lines with only spaces */
-    if (t.find_first_not_of(' ') == string::npos)
-        return true;
-
-    /** if line doesn't start with tab, it's not part of the current target */
-    if (t[0] != '\t')
+    vector<BuildGraph::Id> cycle;
+    if (!graph.sort(roots, order, cycle)) {
+        cycleError(graph, cycle);
         return false;
-
-    /** read the task line, skipping the leading tab character */
-    tasks.push_back(t.substr(1));
+    }
     return true;
 }
 
-/** build a map of Targets by parsing the Cakefile lines, a line that 1) is not
-    part of a target's indented tasks block 2) is non-empty and 3) does not
-    have a colon is an ERROR! If 1) == true && 2) == true && we FOUND a colon,
-    interpret that line as a new target and place it in the map
-
-    e.g.
-    Once we reach a line like this:
-    myTarget: dep1 dep2
-        ...tasks...
-
-    Then we call parseAdjacent on the first line parseTask in a loop to read
-    the indented ...tasks... block */
-bool parseTargets(TargetMap& nodes, vector<string>& lines)
+/** like sortTargets, but only for the requested goals, so "order" ends up
+    with just the goals and everything they (transitively) depend on...
+    targets nobody asked for are never even looked at
+
+    e.g. pie --make app
+    app: main.o         order = [main.o, app]
+    main.o: main.cpp    (test.o and test are left alone)
+    test: test.o
+    test.o: test.cpp */
+bool sortGoals(const BuildGraph& graph, const vector<string>& goals,
+               vector<BuildGraph::Id>& order)
 {
-    unsigned int lineNo = 1;
-    auto it = lines.begin();
-
-    while (it != lines.end()) {
-        if (it->find_first_not_of(' ') == string::npos) {
-            ++it; ++lineNo;
-            continue;
-        }
-
-        auto pos = it->find(":");
-        if ((pos == string::npos) || !pos) {
-            lineError(lineNo, "no target");
+    vector<BuildGraph::Id> roots;
+    for (const string& goal : goals) {
+        BuildGraph::Id id = graph.find(goal);
+        if (id == BuildGraph::NONE || !graph.target(id)) {
+            cerr << "Error: no target [" << goal << "]\n";
             return false;
         }
+        roots.push_back(id);
+    }
+    return sortTargets(graph, roots, order);
+}
 
-        string name = it->substr(0, pos);
-
-        /** emplace() is a method which adds to the hash table
-            (TargetMap == unordered_map == hash table)
-
-            It is a VARIADIC function where the first argument is the KEY and
-            all subsequent arguments are forwarded to the constructor of the
-            Target which will be created in the hash table
-
-            The python equivalent:
+/** the stuff in this function uses Unix "system calls" to execute tasks...
+    specifically Process posix_spawn()s the command (vfork + exec), either
+    directly or through the shell, i.e. sh -c "some command" when the line
+    needs one, then waits for it and hands us the real exit code.
+
+    Everything goes to "out", the output of the job running this task, which
+    keeps it from getting mixed up with the output of other jobs. With
+    --trace the task is a span on the track of worker "slot" */
+bool doTask(const string& task, JobOutput& out, Trace* trace, unsigned int slot,
+            RemotePool* remote, Throttle& throttle) {
+  Trace::Span span(trace, task, "task", slot);
+  out.out("@" + task + "\n");
+
+  /** with --workers the task is sent to the worker of this slot. If it
+      can't be sent it's run here after all, but once the worker has it the
+      task may have run already, so losing the worker then fails it */
+  int status;
+  RemotePool::Result result = remote ? remote->run(slot, task, out.sink(), status)
+                                     : RemotePool::UNREACHED;
+  if (result == RemotePool::LOST) {
+    out.err("Error: lost the worker running [" + task + "]\n");
+    return false;
+  }
+  if (result == RemotePool::UNREACHED) {
+    if (remote)
+      out.err("Warning: no worker for [" + task + "], running it here\n");
+
+    /** only what runs here loads this machine, see Throttle */
+    Throttle::Slot busy(throttle);
+    Process proc;
+    if (!proc.start(task)) {
+      out.err(task + ": " + strerror(errno) + "\n");
+      return false;
+    }
+    status = proc.wait(out.sink());
+  }
 
-            nodes = dict()
-            nodes[name] = Target(name) # notice Target::Target() accepts name */
-        nodes.emplace(name, name);
-        parseAdjacent(it->substr(pos + 1), nodes.at(name));
+  if (status != 0)
+    out.err("Error: [" + task + "] exited with code " + to_string(status) + "\n");
 
-        /** 1) pre-increment the iterator 2) compare it with lines.end()
-            3) if we're not at the end yet, we should increment the lineNo
-            (used for error reporting)
+  /** like Make, a command is successful if it exited with code 0 */
+  return status == 0;
+}
 
-            technically ++lineNo could be in the while loop body, I'd like to
-            emphasize the "it" and "lineNo" are ALWAYS incremented together,
-            (see the if statement above, they're also incremented together)
-            hence putting it in the while loop condition*/
-        while (++it != lines.end() && ++lineNo) {
-            if (!parseTask(*it, nodes.at(name).tasks))
-                break;
+/** loop through all tasks of a target (with their variables expanded),
+    stopping at the first one that fails */
+bool processTarget(const vector<string>& tasks, JobOutput& out, Trace* trace,
+                   unsigned int slot, RemotePool* remote, Throttle& throttle)
+{
+    for (const string& task : tasks) {
+        if (!doTask(task, out, trace, slot, remote, throttle)) {
+            taskError(out, task);
+            return false;
         }
     }
 
     return true;
 }
 
-/** DFS (depth first search), push the current target into the vector "order"
-    after parsing all its adjacent nodes (dependencies!!) first... this makes
-    sense since we can't finish the current target until those dependencies are
-    done first */
-void topologicalSort
-(
-    TargetMap& nodes,
-    const string& id,
-    StringSet& visited,
-    vector<string>& order
-)
+/** after a target ran, remember the dependencies its tasks wrote into its
+    depfile (e.g. the headers from g++ -MMD) for the next build */
+void readDepfile(const Target& tgt, DepsLog& deps, JobOutput& out)
 {
-    if (visited.find(id) != visited.end())
+    MappedFile file;
+    vector<string> found;
+    if (!file.open(tgt.depfile) || !parseDepfile(file.view(), found)) {
+        out.err("Warning: target [" + tgt.name + "] has no valid depfile ["
+                + tgt.depfile + "]\n");
+        deps.set(tgt.name, {});
         return;
-
-    visited.emplace(id);
-    for (const string& adj : nodes.at(id).adjacent)
-        topologicalSort(nodes, adj, visited, order);
-    order.push_back(id);
+    }
+    deps.set(tgt.name, move(found));
 }
 
-/** one way to do topological sort is doing a DFS on each connected component
-    in the DAG, that's why we iterate through the TargetMap */
-void sortTargets(TargetMap& nodes, vector<string>& order)
+/** command line options of --make */
+struct MakeOptions
 {
-    StringSet visited;
-    for (auto& p : nodes)
-        topologicalSort(nodes, p.first, visited, order);
-}
+    unsigned int jobs = 0;  /** -j, targets running at the same time (0 if
+                                not given: 1, or the pool of a parent make) */
+    bool always = false;    /** -B, ignore timestamps */
+    bool cache = false;     /** --cache, use the action cache in .pie/cache */
+    string trace;           /** --trace, Chrome trace-event file to write */
+    double maxLoad = 0;     /** --max-load, no new tasks above this load */
+    uint64_t maxMemory = 0; /** --max-memory, or above this many MiB in use */
+    vector<string> workers; /** --workers, pie --worker processes to run tasks */
+    vector<string> goals;   /** targets to build, all of them if empty */
+    bool watch = false;     /** --watch, rebuild whenever an input changes */
+};
 
-/** the stuff in this function uses Unix "system calls" to execute tasks...
-    specifically we first "fork" a child process and let the process "exec"
-    the command string using the BASH shell, i.e. bash -c "some command" */
-bool doTask(string task) {
-  cout << "@" << task << endl;
+/** run all targets, up to "jobs" of them at the same time; a target is only
+    started once every target it depends on has finished (see Executor).
+    Targets whose file is newer than all of their dependencies are skipped,
+    unless "always" is set. The $(NAME) variables in tasks are expanded once
+    a target turns out to be stale.
+
+    How long each target took is kept in .pie/log, the next build uses that
+    to start the targets on the longest chain first. Dependencies read from
+    depfiles are kept in .pie/deps and count for the staleness check.
+
+    With the action cache, a stale target whose commands and inputs were
+    seen before gets its output restored instead of being run.
+
+    Tasks only run while holding a slot of the jobserver, the one of a
+    parent make (unless -j is given) or one of our own, shared with the make
+    and pie processes started by the tasks.
+
+    With --max-load/--max-memory, no new tasks start while the machine is
+    over either limit (see Throttle). With --trace, a span for every target
+    and task is written to that file (open it in chrome://tracing or
+    ui.perfetto.dev). With --workers, tasks run on pie --worker processes
+    (see RemotePool) */
+bool processTargets(const BuildGraph& graph, Variables& vars,
+                    const vector<BuildGraph::Id>& order,
+                    const MakeOptions& opts)
+{
+    ActionCache cache;
+
+    Jobserver jobserver;
+    unsigned int jobs = opts.jobs;
+    if (!jobs && jobserver.join()) {
+        jobs = jobserver.jobs();
+        if (!jobs)
+            jobs = thread::hardware_concurrency();
+    } else if (jobs > 1) {
+        jobserver.create(jobs);
+    }
+    if (!jobs)
+        jobs = 1;
+    Executor executor(graph, jobs);
+    Throttle throttle(opts.maxLoad, opts.maxMemory);
+    RemotePool pool(opts.workers, jobs);
+    RemotePool* remote = pool.empty() ? nullptr : &pool;
+
+    Trace trace;
+    Trace* tracing = opts.trace.empty() ? nullptr : &trace;
+    executor.setTrace(tracing);
+
+    /** targets that never ran before are assumed to take an average time */
+    BuildLog log;
+    if (log.load()) {
+        vector<uint64_t> weights(graph.size(), 0);
+        vector<BuildGraph::Id> unknown;
+        uint64_t sum = 0, known = 0;
+        for (BuildGraph::Id id : order) {
+            int64_t ms = log.duration(graph.name(id));
+            if (ms < 0) {
+                unknown.push_back(id);
+            } else {
+                weights[id] = ms + 1;
+                sum += ms + 1;
+                ++known;
+            }
+        }
+        for (BuildGraph::Id id : unknown)
+            weights[id] = known ? sum / known : 1;
+        executor.setWeights(move(weights));
+    }
 
-  system(task.c_str());
+    DepsLog deps;
+    deps.load();
 
-  /** like Make, a command is successful if it exited with code 0 */
-  return true;  // WIFEXITED(status) && WEXITSTATUS(status) == 0
-}
+    bool ok = executor.run(order, [&](Target& tgt, unsigned int slot) {
+        vector<string> implicit;
+        if (!tgt.depfile.empty())
+            implicit = deps.get(tgt.name);
 
-/** loop through all tasks in the target */
-bool processTarget(Target& tgt)
-{
-    for (const string& task : tgt.tasks) {
-        if (!doTask(task)) {
-            //taskError(task);
+        if (!opts.always && !isStale(tgt, implicit))
             return true;
+
+        /** with one job at a time, show output as it happens */
+        JobOutput out(jobs == 1);
+
+        vector<string> tasks;
+        tasks.reserve(tgt.tasks.size());
+        for (const string& task : tgt.tasks) {
+            string cycle;
+            tasks.emplace_back();
+            if (!vars.expand(task, tasks.back(), cycle)) {
+                out.err("Error: variable [" + cycle + "] refers to itself\n");
+                targetError(out, tgt.name);
+                return false;
+            }
         }
-    }
 
-    return true;
-}
+        string key;
+        bool cacheable = opts.cache && !tasks.empty()
+                      && cache.key(tgt, tasks, key, implicit);
+        if (cacheable && cache.restore(key, tgt)) {
+            out.out("[cached] " + tgt.name + "\n");
+            return true;
+        }
 
-/** loop through all targets */
-bool processTargets(TargetMap& nodes, vector<string>& order)
-{
-    for (const string& name : order) {
-        if (!processTarget(nodes.at(name))) {
-            targetError(name);
+        Jobserver::Token token(jobserver);
+        auto start = chrono::steady_clock::now();
+        if (!processTarget(tasks, out, tracing, slot, remote, throttle)) {
+            targetError(out, tgt.name);
             return false;
         }
-    }
+        auto elapsed = chrono::steady_clock::now() - start;
+        log.record(tgt.name,
+                   chrono::duration_cast<chrono::milliseconds>(elapsed).count());
 
-    return true;
+        if (!tgt.depfile.empty())
+            readDepfile(tgt, deps, out);
+
+        if (cacheable)
+            cache.store(key, tgt);
+        return true;
+    });
+
+    log.save();
+    deps.save();
+    if (tracing && !trace.save(opts.trace))
+        cerr << "Warning: could not write trace [" << opts.trace << "]\n";
+    return ok;
 }
 
 /*******************************************************************************
  * @SUMMARY:
  *
- * 1. read the Piefile
- * 2. build a map of Target objects from the lines
- * 3. do a topological sort on the map (the map is a DAG)
+ * 1. map the Piefile into memory
+ * 2. build a map of Target objects from its lines (see core/parser.hpp)
+ * 3. do a topological sort on the map (the map is a DAG, see BuildGraph)
  * 4. iterate through the "order" vector, which represents the order in which
- *    tasks should be done to satisfy the dependencies you defined
+ *    tasks should be done to satisfy the dependencies you defined (with
+ *    --jobs N, independent targets from that order run in parallel, and
+ *    targets that are already up to date are skipped)
  *
  *******************************************************************************
  * @TIPS:
  *
  * (1)
  * Notice objects are often passed by reference when changes need to be visible
- * to the caller, e.g. readFile() accepts the vector by reference!
+ * to the caller, e.g. parseTargets() accepts the TargetMap by reference!
  *
  * (2)
  * Keyword "auto" is like "var" or "let" in other languages, it's used when we
@@ -466,39 +557,238 @@ bool processTargets(TargetMap& nodes, vector<string>& order)
  * This is useful because many of the operating system API's (e.g. execvp) are
  * desgined to work with C-strings.
  ******************************************************************************/
-int make()
+/** steps 1-3 below: parse the Piefile into nodes and sort them into order.
+    If the graph database in .pie already holds the result for this exact
+    Piefile, that is loaded instead and the Piefile isn't even read */
+bool loadTargets(TargetMap& nodes, Variables& vars, vector<string>& order)
 {
-    vector<string> lines;
-    if (!readFile("Piefile", lines)) {
+    if (loadGraph("Piefile", nodes, vars, order))
+        return true;
+
+    /** map the Piefile into memory instead of reading it line by line */
+    MappedFile file;
+    if (!file.open("Piefile")) {
         perror("readFile"); //Can not fine the Piefile
-        return 1;
+        return false;
     }
 
-    /** (1) uncomment this block, it'll print the lines read from Piefile */
-    // for (string& l : lines)
-    //    cout << l << "\n";
+    /** (1) uncomment this block, it'll print the Piefile as we see it */
+    // cout << file.view();
     // return 0;
 
-    TargetMap nodes;
-    if (!parseTargets(nodes, lines))
-        return 1;
+    ParseError error;
+    if (!parseTargets(file.view(), nodes, vars, error)) {
+        lineError(error.line, error.msg);
+        return false;
+    }
 
-    /** (2) prints the Target objects parsed from the vector of file lines */
+    /** (2) prints the Target objects parsed from the file */
     // for (auto& p : nodes)
     //     cout << "(" << p.first << ") " << p.second << "\n";
     // return 0;
 
-    vector<string> order;
-    sortTargets(nodes, order);
+    BuildGraph graph(nodes);
+    vector<BuildGraph::Id> ids;
+    if (!sortTargets(graph, {}, ids))
+        return false;
+    for (BuildGraph::Id id : ids)
+        order.push_back(graph.name(id));
+
+    /** failing to save only means the next run parses again */
+    saveGraph("Piefile", nodes, vars, order);
+    return true;
+}
+
+/** turn the pattern rules in nodes into the targets that the goals need,
+    or that any target needs if there are no goals (or "everything" is set),
+    see PatternRules. When targets were added, names (the order from
+    loadTargets) is emptied, it doesn't cover them */
+void applyPatterns(TargetMap& nodes, vector<string>& names,
+                   const vector<string>& goals, bool everything = false)
+{
+    PatternRules rules(nodes);
+    if (rules.empty())
+        return;
+
+    names.erase(remove_if(names.begin(), names.end(),
+                          [&](const string& name) { return !nodes.count(name); }),
+                names.end());
+
+    vector<string> roots = goals;
+    if (goals.empty() || everything)
+        roots.insert(roots.end(), names.begin(), names.end());
+    if (rules.instantiate(nodes, roots))
+        names.clear();
+}
+
+/** the targets to build in order: with goals on the command line, only
+    their dependency closure, otherwise everything ("names" from loadTargets,
+    sorted again if it's empty) */
+bool goalOrder(const BuildGraph& graph, const vector<string>& names,
+               const vector<string>& goals, vector<BuildGraph::Id>& order)
+{
+    if (!goals.empty())
+        return sortGoals(graph, goals, order);
+    if (names.empty())
+        return sortTargets(graph, {}, order);
+
+    for (const string& name : names)
+        order.push_back(graph.find(name));
+    return true;
+}
+
+int make(const MakeOptions& opts)
+{
+    TargetMap nodes;
+    Variables vars;
+    vector<string> names;
+    if (!loadTargets(nodes, vars, names))
+        return 1;
+    applyPatterns(nodes, names, opts.goals);
+
+    BuildGraph graph(nodes);
+    vector<BuildGraph::Id> order;
+    if (!goalOrder(graph, names, opts.goals, order))
+        return 1;
 
     /** prints the order targets will be processed (topological) */
     cout << "[...Target Order...]\n";
-    for (auto& name : order)
-        cout << name << "\n";
+    for (BuildGraph::Id id : order)
+        cout << graph.name(id) << "\n";
     // return 0;
 
     cout << "[...Processing...]\n";
-    return processTargets(nodes, order) ? 0 : 1;
+    return processTargets(graph, vars, order, opts) ? 0 : 1;
+}
+
+/** watch the inputs of the targets in "order": the plain files in the graph
+    (outputs of other targets are left alone, we write those ourselves), the
+    dependencies found in depfiles and the Piefile itself */
+void watchInputs(const BuildGraph& graph, const vector<BuildGraph::Id>& order,
+                 Watcher& watcher,
+                 unordered_map<string, vector<BuildGraph::Id>>& implicitUsers)
+{
+    DepsLog deps;
+    deps.load();
+
+    watcher.add("Piefile");
+    implicitUsers.clear();
+    for (BuildGraph::Id id : order) {
+        for (BuildGraph::Id dep : graph.deps(id))
+            if (!graph.target(dep))
+                watcher.add(graph.name(dep));
+
+        const Target& tgt = *graph.target(id);
+        if (tgt.depfile.empty())
+            continue;
+        for (const string& path : deps.get(tgt.name)) {
+            BuildGraph::Id node = graph.find(path);
+            if (node != BuildGraph::NONE && graph.target(node))
+                continue;
+            watcher.add(path);
+            implicitUsers[path].push_back(id);
+        }
+    }
+}
+
+/** mark the nodes of the changed paths (and the targets using them as
+    implicit dependencies), and everything downstream of them, in "marks".
+    Returns true if the Piefile itself changed */
+bool markChanged(const BuildGraph& graph, const vector<string>& changed,
+                 const unordered_map<string, vector<BuildGraph::Id>>& implicitUsers,
+                 vector<char>& marks)
+{
+    bool piefile = false;
+    vector<BuildGraph::Id> queue;
+    for (const string& path : changed) {
+        cout << "[changed] " << path << "\n";
+        if (path == "Piefile")
+            piefile = true;
+        BuildGraph::Id id = graph.find(path);
+        if (id != BuildGraph::NONE)
+            queue.push_back(id);
+        auto users = implicitUsers.find(path);
+        if (users != implicitUsers.end())
+            queue.insert(queue.end(), users->second.begin(), users->second.end());
+    }
+
+    /** marks may be set from before, so keep track of our own walk */
+    vector<char> seen(graph.size(), 0);
+    while (!queue.empty()) {
+        BuildGraph::Id id = queue.back();
+        queue.pop_back();
+        if (seen[id])
+            continue;
+        seen[id] = marks[id] = 1;
+        for (BuildGraph::Id user : graph.dependents(id))
+            queue.push_back(user);
+    }
+    return piefile;
+}
+
+/** pie --make --watch: build once, then keep the graph in memory and rebuild
+    whenever an input changes. Only the targets downstream of the changed
+    files (the affected sub-DAG) are looked at again, in the same order as
+    the full build; the Piefile is only parsed again when it changes */
+int watch(const MakeOptions& opts)
+{
+    for (;;) {
+        TargetMap nodes;
+        Variables vars;
+        vector<string> names;
+        Watcher watcher;
+        if (!watcher.ok()) {
+            cerr << "Error: --watch needs inotify (Linux)\n";
+            return 1;
+        }
+
+        /** a broken Piefile: wait for it to be fixed */
+        if (!loadTargets(nodes, vars, names)) {
+            vector<string> changed;
+            watcher.add("Piefile");
+            if (!watcher.wait(changed))
+                return 1;
+            continue;
+        }
+        applyPatterns(nodes, names, opts.goals);
+
+        BuildGraph graph(nodes);
+        vector<BuildGraph::Id> order;
+        if (!goalOrder(graph, names, opts.goals, order))
+            return 1;
+
+        cout << "[...Processing...]\n";
+        processTargets(graph, vars, order, opts);
+
+        unordered_map<string, vector<BuildGraph::Id>> implicitUsers;
+        watchInputs(graph, order, watcher, implicitUsers);
+
+        vector<char> affected(graph.size());
+        for (;;) {
+            cout << "[...Watching " << order.size() << " targets...]" << endl;
+            vector<string> changed;
+            if (!watcher.wait(changed))
+                return 1;
+
+            /** everything downstream of the changed files */
+            fill(affected.begin(), affected.end(), 0);
+            if (markChanged(graph, changed, implicitUsers, affected))
+                break;
+
+            vector<BuildGraph::Id> subset;
+            for (BuildGraph::Id id : order)
+                if (affected[id])
+                    subset.push_back(id);
+            if (subset.empty())
+                continue;
+
+            cout << "[...Processing " << subset.size() << " targets...]\n";
+            processTargets(graph, vars, subset, opts);
+
+            /** new depfiles may have turned up new headers */
+            watchInputs(graph, order, watcher, implicitUsers);
+        }
+    }
 }
 
 
@@ -540,22 +830,113 @@ int make()
 // parser_class parser_class;
 // parser_class.parser_file("test.pie");
 
-int main(int argc, char* argv[]) {
-    //Beep(1000,100);
-//   jms::Spinner s("Doing something cool", jms::classic);
-//   s = jms::Spinner("Now Starting the next task", jms::classic);
-//   s.start();
+/** what pie --daemon keeps loaded between the command lines of its
+    clients: the carescript interpreter, and the parsed Piefile along with
+    which of its targets may be stale */
+struct Resident
+{
+    carescript::Interpreter interpreter;
+    ScriptCache script;
+
+    unique_ptr<TargetMap> nodes;  /** the graph points into it */
+    unique_ptr<Variables> vars;
+    vector<string> names;
+    unique_ptr<BuildGraph> graph;
+    unique_ptr<Watcher> watcher;
+    unordered_map<string, vector<BuildGraph::Id>> implicitUsers;
+    vector<char> dirty;           /** per node, whether it may be stale */
+
+    Resident()
+    {
+        interpreter.hosted = true;
+        interpreter.save(0);
+    }
+};
 
-//   this_thread::sleep_for(2s);
-//   s.setAnimation(jms::dots);
-//   this_thread::sleep_for(2s);
+/** --make for a daemon client. The graph stays loaded until the Piefile
+    changes, and inotify tells us which files changed since the last build
+    (or while it ran): only the targets downstream of those (and the ones
+    that failed or never ran) are checked again, everything else is known
+    to be up to date without looking at the disk */
+int residentMake(Resident& r, const MakeOptions& opts)
+{
+    /** a goal without a target may be one a pattern rule can make */
+    bool missing = false;
+    for (const string& goal : opts.goals) {
+        BuildGraph::Id id = r.graph ? r.graph->find(goal) : BuildGraph::NONE;
+        missing = missing || id == BuildGraph::NONE || !r.graph->target(id);
+    }
 
-//   s.finish(jms::FinishedState::SUCCESS, "Failed to finish that task");
-  // Intialization
-  // Initialize();
+    vector<string> changed;
+    bool reload = !r.graph || missing || !r.watcher->ok()
+               || !r.watcher->wait(changed, 0)
+               || markChanged(*r.graph, changed, r.implicitUsers, r.dirty);
+    if (reload) {
+        r.graph.reset();
+        r.nodes.reset(new TargetMap);
+        r.vars.reset(new Variables);
+        r.names.clear();
+        r.watcher.reset(new Watcher);
+        if (!loadTargets(*r.nodes, *r.vars, r.names))
+            return 1;
+        applyPatterns(*r.nodes, r.names, opts.goals, true);
+        r.graph.reset(new BuildGraph(*r.nodes));
+        r.dirty.assign(r.graph->size(), 1);
+    }
 
-  argparse::ArgumentParser program("pie");
+    const BuildGraph& graph = *r.graph;
+    vector<BuildGraph::Id> order;
+    if (!goalOrder(graph, r.names, opts.goals, order))
+        return 1;
+
+    /** as in isStale, a target without a file (a phony one, or one whose
+        output was never made) runs every time, and so does everything
+        depending on it */
+    vector<char> run(graph.size(), 0);
+    vector<BuildGraph::Id> subset;
+    for (BuildGraph::Id id : order) {
+        TimeStamp stamp;
+        run[id] = opts.always || r.dirty[id] || !fileTime(graph.name(id), stamp);
+        for (BuildGraph::Id dep : graph.deps(id))
+            run[id] = run[id] || run[dep];
+        if (run[id])
+            subset.push_back(id);
+    }
 
+    /** watch before the tasks run, so a file changed while they do isn't
+        missed. The outputs too, a target whose file was deleted is stale */
+    watchInputs(graph, order, *r.watcher, r.implicitUsers);
+    for (BuildGraph::Id id : order)
+        r.watcher->add(graph.name(id));
+
+    cout << "[...Processing " << subset.size() << " of " << order.size()
+         << " targets...]\n";
+    bool ok = processTargets(graph, *r.vars, subset, opts);
+    if (ok)
+        for (BuildGraph::Id id : subset)
+            r.dirty[id] = 0;
+
+    /** the files of the targets that just ran changed because of us, any
+        other change happened during the build and counts for the next one */
+    vector<string> during;
+    bool lost = !r.watcher->wait(changed, 0);
+    for (const string& path : changed) {
+        BuildGraph::Id id = graph.find(path);
+        if (id == BuildGraph::NONE || !run[id])
+            during.push_back(path);
+    }
+    lost = markChanged(graph, during, r.implicitUsers, r.dirty) || lost;
+
+    /** new depfiles may have turned up new headers */
+    watchInputs(graph, order, *r.watcher, r.implicitUsers);
+    if (lost)
+        r.graph.reset();
+    return ok ? 0 : 1;
+}
+
+/** the command line of pie, see main() */
+void addArguments(argparse::ArgumentParser& program)
+{
   program.add_argument("--build")
       .help("build root dir")
       .default_value(false)
@@ -566,25 +947,107 @@ int main(int argc, char* argv[]) {
       .default_value(false)
       .implicit_value(true);
 
+  program.add_argument("targets")
+      .help("Piefile targets to build with --make (default: all)")
+      .nargs(argparse::nargs_pattern::any)
+      .default_value(vector<string>{});
+
+  program.add_argument("-j", "--jobs")
+      .help("Number of Piefile targets to run in parallel with --make")
+      .scan<'i', int>();
+
+  program.add_argument("-B", "--always-make")
+      .help("Run every Piefile target, even the ones that are up to date")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--cache")
+      .help("Restore outputs of Piefile targets from the .pie/cache action cache")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--max-load")
+      .help("Don't start new Piefile tasks while the load average is at least this")
+      .default_value(0.0)
+      .scan<'g', double>();
+
+  program.add_argument("--max-memory")
+      .help("Don't start new Piefile tasks while more than this many MiB of memory are in use")
+      .default_value(0)
+      .scan<'i', int>();
+
+  program.add_argument("--watch")
+      .help("Keep running after --make and rebuild whenever an input file changes")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--trace")
+      .help("Write a Chrome trace-event JSON file of the --make run")
+      .default_value(string(""));
+
+  program.add_argument("--daemon")
+      .help("Stay running and serve pie --client command lines from .pie/daemon.sock")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--client")
+      .help("Have the daemon of this directory run the command (if there is one)")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--workers")
+      .help("Run the Piefile tasks of --make on these pie --worker processes (host:port,...)")
+      .default_value(string(""));
+
+  program.add_argument("--worker")
+      .help("Run tasks sent by pie --make --workers, listening on [host:]port");
+
   program.add_argument("--download")
       .default_value(std::string("none"))
       .help("Downloads a repo (repository) in the root dir")
       .default_value(false)
       .implicit_value(true);
+}
 
-  try {
-    program.parse_args(argc, argv);
-  } catch (const std::runtime_error& err) {
-    std::cerr << err.what() << std::endl;
-    std::cerr << program;
-    std::exit(1);
-  }
-
+/** do what the parsed command line asks for, returns the exit status. The
+    daemon passes what it keeps loaded in "resident" */
+int runCommand(argparse::ArgumentParser& program, Resident* resident)
+{
+  int status = 0;
   if (program["--build"] == true) {
-    read_pieScript();
+    if (resident) {
+      status = runPieScript(resident->interpreter, &resident->script);
+      /** the command ends there, like the process does without a daemon */
+      if (resident->interpreter.exited)
+        return status;
+    } else {
+      read_pieScript();
+    }
   }
   if (program["--make"] == true) {
-    make();
+    MakeOptions opts;
+    if (auto jobs = program.present<int>("--jobs"))
+        opts.jobs = *jobs > 0 ? *jobs : 1;
+    opts.always = program["--always-make"] == true;
+    opts.cache = program["--cache"] == true;
+    opts.maxLoad = program.get<double>("--max-load");
+    int maxMemory = program.get<int>("--max-memory");
+    opts.maxMemory = maxMemory > 0 ? maxMemory : 0;
+    opts.trace = program.get<string>("--trace");
+    stringstream workers(program.get<string>("--workers"));
+    for (string worker; getline(workers, worker, ',');)
+      if (!worker.empty())
+        opts.workers.push_back(worker);
+    opts.goals = program.get<vector<string>>("targets");
+    opts.watch = program["--watch"] == true;
+    if (resident && opts.watch) {
+      cerr << "Error: --watch can't be run by the daemon\n";
+      status = 1;
+    } else if (resident) {
+      status = residentMake(*resident, opts);
+    } else {
+      status = opts.watch ? watch(opts) : make(opts);
+    }
   }
   if (program["--download"] == true) {
     auto input = program.get<string>("--download");
@@ -595,5 +1058,88 @@ int main(int argc, char* argv[]) {
 
   }
 
-  return 0;
-}
\ No newline at end of file
+  return status;
+}
+
+/** pie --daemon: serve the command lines of clients (pie --client ...) one
+    after the other, with everything in "resident" loaded only once */
+int serve()
+{
+  DaemonServer server;
+  if (!server.listen()) {
+    cerr << "Error: can't serve [" << DAEMON_SOCKET
+         << "], is a daemon running here already?\n";
+    return 1;
+  }
+
+#ifndef _WIN32
+  /** a client that went away must not take the daemon with it. Unlike
+      SIG_IGN, a handler isn't passed on to the tasks we start */
+  signal(SIGPIPE, [](int) { });
+#endif
+
+  Resident resident;
+  cout << "[...Serving " << DAEMON_SOCKET << "...]" << endl;
+
+  vector<string> args;
+  while (server.accept(args)) {
+    int status;
+    argparse::ArgumentParser program("pie");
+    addArguments(program);
+    try {
+      program.parse_args(args);
+      status = runCommand(program, &resident);
+    } catch (const std::runtime_error& err) {
+      std::cerr << err.what() << std::endl;
+      status = 1;
+    }
+    server.finish(status);
+  }
+  return 1;
+}
+
+int main(int argc, char* argv[]) {
+    //Beep(1000,100);
+//   jms::Spinner s("Doing something cool", jms::classic);
+//   s = jms::Spinner("Now Starting the next task", jms::classic);
+//   s.start();
+
+//   this_thread::sleep_for(2s);
+//   s.setAnimation(jms::dots);
+//   this_thread::sleep_for(2s);
+
+//   s.finish(jms::FinishedState::SUCCESS, "Failed to finish that task");
+  // Intialization
+  // Initialize();
+
+  argparse::ArgumentParser program("pie");
+  addArguments(program);
+
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::runtime_error& err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    std::exit(1);
+  }
+
+  if (program["--daemon"] == true)
+    return serve();
+  if (auto address = program.present<string>("--worker"))
+    return serveWorker(*address);
+
+  /** without a daemon the client just does the work itself, and so it does
+      with a parent make's pool the daemon couldn't use */
+  if (program["--client"] == true && !Jobserver::passedAsFds()) {
+    vector<string> args;
+    for (int i = 0; i < argc; ++i)
+      if (string(argv[i]) != "--client")
+        args.push_back(argv[i]);
+    int status;
+    if (daemonRequest(args, status))
+      return status;
+  }
+
+  return runCommand(program, nullptr);
+}
+
@@ -43,14 +43,14 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
     
     {"echo",{-1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
         cc_builtin_if_ignore();
-        for(auto i : args) {
+        for(auto& i : args) {
             std::cout << i.printable();
         }
         return script_null;
     }}},
     {"echoln",{-1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
         cc_builtin_if_ignore();
-        for(auto i : args) {
+        for(auto& i : args) {
             std::cout << i.printable();
         }
         std::cout << "\n";
@@ -62,7 +62,7 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
         std::cout << get_value<ScriptStringValue>(args[0]); std::cout.flush();
         std::string inp;
         std::getline(std::cin,inp);
-        return new ScriptStringValue(inp);
+        return ScriptVariable(inp);
     }}},
 
     {"to_number",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
@@ -80,13 +80,13 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
             _cc_error("invalid input: \"" + s + "\"");
         }
 
-        return new ScriptNumberValue(num);
+        return ScriptVariable(num);
     }}},
     {"to_string",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
         cc_builtin_if_ignore();
         cc_builtin_var_requires(args[0],ScriptNumberValue,ScriptStringValue);
         if(is_typeof<ScriptNumberValue>(args[0])) {
-            return new ScriptStringValue(std::to_string(get_value<ScriptNumberValue>(args[0])));
+            return ScriptVariable(std::to_string(get_value<ScriptNumberValue>(args[0])));
         }
         else if(is_typeof<ScriptStringValue>(args[0])) {
             return args[0];
@@ -131,7 +131,11 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
     {"exit",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
         cc_builtin_if_ignore();
         cc_builtin_var_requires(args[0],ScriptNumberValue);
-        std::exit((int)get_value<ScriptNumberValue>(args[0]));
+        int status = (int)get_value<ScriptNumberValue>(args[0]);
+        if(!settings.interpreter.hosted) std::exit(status);
+        settings.interpreter.exited = true;
+        settings.interpreter.exit_status = status;
+        settings.exit = true;
         return script_null;
     }}},
     {"system",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
@@ -249,7 +253,7 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
         while(ifile.good()) r += ifile.get();
         if(!r.empty()) r.pop_back();
 
-        return new ScriptStringValue{r};
+        return ScriptVariable(std::move(r));
     }}},
     {"write",{2,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
         cc_builtin_if_ignore();
@@ -290,7 +294,7 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
         settings.error_msg = run_label(get_value<ScriptNameValue>(args[0]),settings.labels,tset,"",run_args);
         if(settings.error_msg != "") settings.raw_error = true;
 
-        return tset.return_value;
+        return std::move(tset.return_value);
     }}},
     {"return",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
         cc_builtin_if_ignore();
@@ -322,7 +326,7 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
             if(idx < 0) _cc_error("index undeflow");
 
             str.erase(str.begin()+idx);
-            settings.variables[get_value<ScriptNameValue>(args[1])] = new ScriptStringValue(str);
+            settings.variables[get_value<ScriptNameValue>(args[1])] = ScriptVariable(str);
         }
         else if(get_value<ScriptNameValue>(args[0]) == "INSERT") {
             if(args.size() != 4) _cc_error("requires 4 arguments");
@@ -334,7 +338,7 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
             if(idx < 0) _cc_error("index undeflow");
 
             str = str.substr(0,idx-1) + get_value<ScriptStringValue>(args[3]) + str.substr(idx,str.size()-1);
-            settings.variables[get_value<ScriptNameValue>(args[1])] = new ScriptStringValue(str);
+            settings.variables[get_value<ScriptNameValue>(args[1])] = ScriptVariable(str);
         }
         else if(get_value<ScriptNameValue>(args[0]) == "PUT") {
             if(args.size() != 4) _cc_error("requires 4 arguments");
@@ -346,18 +350,18 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
             if(idx < 0) _cc_error("index undeflow");
             
             str = str.substr(0,idx) + get_value<ScriptStringValue>(args[3]) + str.substr(idx+1,str.size()-1);
-            settings.variables[get_value<ScriptNameValue>(args[1])] = new ScriptStringValue(str);
+            settings.variables[get_value<ScriptNameValue>(args[1])] = ScriptVariable(str);
         }
         else if(get_value<ScriptNameValue>(args[0]) == "BACK") {
             if(args.size() != 2) _cc_error("requires 2 arguments");
             if(str.empty()) _cc_error("string empty");
 
-            return new ScriptStringValue(std::string(1,str.back()));
+            return ScriptVariable(std::string(1,str.back()));
         }
         else if(get_value<ScriptNameValue>(args[0]) == "SIZE") {
             if(args.size() != 2) _cc_error("requires 2 arguments"); 
 
-            return new ScriptNumberValue((long double)str.size());
+            return ScriptVariable((long double)str.size());
         }
         else if(get_value<ScriptNameValue>(args[0]) == "AT") {
             if(args.size() != 3) _cc_error("requires 3 arguments");
@@ -367,7 +371,7 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
             if(idx >= str.size()) _cc_error("index overflow");
             if(idx < 0) _cc_error("index undeflow");
 
-            return new ScriptStringValue(std::string(1,str.at(idx)));
+            return ScriptVariable(std::string(1,str.at(idx)));
         }
         else if(get_value<ScriptNameValue>(args[0]) == "SUBSTR") {
             if(args.size() != 4) _cc_error("requires 4 arguments");
@@ -382,7 +386,7 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
             if(idx_to < 0) _cc_error("index undeflow");
             if(idx_to < idx_from) {int t = idx_to; idx_to = idx_from; idx_from = t;}
 
-            return new ScriptStringValue(str.substr(idx_to, idx_from - idx_to));
+            return ScriptVariable(str.substr(idx_to, idx_from - idx_to));
         }
         else {
             _cc_error("unknown enum type");
@@ -398,7 +402,7 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
     }}},
     {"typeof",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
         cc_builtin_if_ignore();
-        return new ScriptStringValue(args[0].get_type());
+        return ScriptVariable(args[0].get_type());
     }}},
 };
 
@@ -444,12 +448,12 @@ inline std::map<std::string,std::vector<ScriptOperator>> default_script_operator
         cc_operator_same_type(right,left,"+");
         cc_operator_var_requires(right,"+",ScriptNumberValue,ScriptStringValue);
         if(is_typeof<ScriptNumberValue>(right)) {
-            return new ScriptNumberValue(
+            return ScriptVariable(
                     get_value<ScriptNumberValue>(left) + get_value<ScriptNumberValue>(right)
                 );
         }
         else {
-            return new ScriptStringValue(
+            return ScriptVariable(
                     get_value<ScriptStringValue>(left) + get_value<ScriptStringValue>(right)
                 );
         }
@@ -458,14 +462,14 @@ inline std::map<std::string,std::vector<ScriptOperator>> default_script_operator
         cc_operator_same_type(right,left,"-");
         cc_operator_var_requires(right,"-",ScriptNumberValue);
         ScriptVariable ret;
-        ret = new ScriptNumberValue(
+        ret = ScriptVariable(
                 get_value<ScriptNumberValue>(left) - get_value<ScriptNumberValue>(right)
             );
         return ret;
     },[](ScriptVariable left, ScriptSettings& settings)->ScriptVariable {
         cc_operator_var_requires(left,"-",ScriptNumberValue);
         ScriptVariable ret;
-        ret = new ScriptNumberValue(
+        ret = ScriptVariable(
                 get_value<ScriptNumberValue>(left) * -1
             );
         return ret;
@@ -474,7 +478,7 @@ inline std::map<std::string,std::vector<ScriptOperator>> default_script_operator
         cc_operator_same_type(right,left,"*");
         cc_operator_var_requires(right,"*",ScriptNumberValue);
         ScriptVariable ret;
-        ret = new ScriptNumberValue(
+        ret = ScriptVariable(
                 get_value<ScriptNumberValue>(left) * get_value<ScriptNumberValue>(right)
             );
 
@@ -488,7 +492,7 @@ inline std::map<std::string,std::vector<ScriptOperator>> default_script_operator
             return script_null;
         }
         ScriptVariable ret;
-        ret = new ScriptNumberValue(
+        ret = ScriptVariable(
                 get_value<ScriptNumberValue>(left) / get_value<ScriptNumberValue>(right)
             );
         return ret;
@@ -497,7 +501,7 @@ inline std::map<std::string,std::vector<ScriptOperator>> default_script_operator
         cc_operator_same_type(right,left,"^");
         cc_operator_var_requires(right,"^",ScriptNumberValue);
         ScriptVariable ret;
-        ret = new ScriptNumberValue(
+        ret = ScriptVariable(
                 std::pow(get_value<ScriptNumberValue>(left), get_value<ScriptNumberValue>(right))
             );
         return ret;
@@ -506,14 +510,14 @@ inline std::map<std::string,std::vector<ScriptOperator>> default_script_operator
     {"is",{{-1,ScriptOperator::DOUBLE,[](ScriptVariable left, ScriptVariable right, ScriptSettings& settings)->ScriptVariable {
         cc_operator_same_type(right,left,"is");
 
-        return new ScriptNumberValue(
+        return ScriptVariable(
                 left == right ? true : false
             );
     }}}},
     {"isnt",{{-1,ScriptOperator::DOUBLE,[](ScriptVariable left, ScriptVariable right, ScriptSettings& settings)->ScriptVariable {
         cc_operator_same_type(right,left,"isnt");
 
-        return new ScriptNumberValue(
+        return ScriptVariable(
                 left == right ? false : true
             );
     }}}},
@@ -521,7 +525,7 @@ inline std::map<std::string,std::vector<ScriptOperator>> default_script_operator
         cc_operator_same_type(right,left,"and");
         cc_operator_var_requires(right,"and",ScriptNumberValue);
         
-        return new ScriptNumberValue(
+        return ScriptVariable(
                 (get_value<ScriptNumberValue>(left) == true && get_value<ScriptNumberValue>(right)) ? true : false
             );
     }}}},
@@ -529,28 +533,28 @@ inline std::map<std::string,std::vector<ScriptOperator>> default_script_operator
         cc_operator_same_type(right,left,"or");
         cc_operator_var_requires(right,"or",ScriptNumberValue);
                 
-        return new ScriptNumberValue(
+        return ScriptVariable(
                 (get_value<ScriptNumberValue>(left) == true || get_value<ScriptNumberValue>(right) == true) ? true : false
             );
     }}}},
     {"more",{{-2,ScriptOperator::DOUBLE,[](ScriptVariable left, ScriptVariable right, ScriptSettings& settings)->ScriptVariable {
         cc_operator_same_type(right,left,"more");
         cc_operator_var_requires(right,"more",ScriptNumberValue);
-        return new ScriptNumberValue(
+        return ScriptVariable(
                 (get_value<ScriptNumberValue>(left) > get_value<ScriptNumberValue>(right)) ? true : false
             );
     }}}},
     {"less",{{-2,ScriptOperator::DOUBLE,[](ScriptVariable left, ScriptVariable right, ScriptSettings& settings)->ScriptVariable {
         cc_operator_same_type(right,left,"less");
         cc_operator_var_requires(right,"less",ScriptNumberValue);
-        return new ScriptNumberValue(
+        return ScriptVariable(
                 (get_value<ScriptNumberValue>(left) < get_value<ScriptNumberValue>(right)) ? true : false
             );
     }}}},
     
     {"not",{{99,ScriptOperator::UNARY,nullptr,[](ScriptVariable left, ScriptSettings& settings)->ScriptVariable {
         cc_operator_var_requires(left,"not",ScriptNumberValue);
-        return new ScriptNumberValue(
+        return ScriptVariable(
                 !get_value<ScriptNumberValue>(left)
             );
     }}}},
@@ -10,6 +10,10 @@
 #include <filesystem>
 #include <exception>
 #include <any>
+#include <memory>
+#include <list>
+#include <typeinfo>
+#include <cstdint>
 
 #include "kittenlexer.hpp"
 
@@ -21,20 +25,88 @@ namespace carescript {
 template<typename _Tp>
 concept ScriptValueType = std::is_base_of<carescript::ScriptValue,_Tp>::value;
 
+// the id of a type, is_typeof and is_same_type compare these instead of
+// type names. The default types are 0 to 3 (Null, Number, String, Name),
+// matching ScriptVariable::Kind, any other type's id is a hash (FNV-1a) of
+// its C++ type name: the same in every run, thread and shared library, so
+// it needs neither a registry nor a lock
+using ScriptTypeId = std::uint64_t;
+
+inline ScriptTypeId script_type_id(const std::type_info& type) {
+    if(type == typeid(ScriptNullValue)) return 0;
+    if(type == typeid(ScriptNumberValue)) return 1;
+    if(type == typeid(ScriptStringValue)) return 2;
+    if(type == typeid(ScriptNameValue)) return 3;
+    ScriptTypeId hash = 14695981039346656037ull;
+    for(const char* c = type.name(); *c != '\0'; ++c) {
+        hash = (hash ^ (unsigned char)*c) * 1099511628211ull;
+    }
+    return hash < 4 ? hash + 4 : hash;
+}
+
+// the type id of a subclass of ScriptValue
+template<ScriptValueType _Tp>
+inline ScriptTypeId script_type_id() {
+    static const ScriptTypeId id = script_type_id(typeid(_Tp));
+    return id;
+}
+
+// the type id of a value's dynamic type
+inline ScriptTypeId script_type_id(const ScriptValue& value) {
+    return script_type_id(typeid(value));
+}
+
+// the characters of a long string or name, shared by all copies of it
+// (reference counted, like the interpreter it isn't thread safe)
+struct ScriptText {
+    std::size_t refs = 1;
+    std::string str;
+};
+
 // Wrapper class to perfom tasks on a
-// subclass of the abstract class "ScriptValue"
+// subclass of the abstract class "ScriptValue".
+// Numbers, strings, names and null are kept inline as a tagged union,
+// only other types (the ones of extensions) are heap allocated
+// ScriptValues in "value".
+// Copies share what's expensive to copy: strings too long for
+// std::string's own buffer are a ScriptText and "value" is shared too.
+// Both are immutable, edit_value() copies a shared value before it's
+// changed
 struct ScriptVariable {
-    std::unique_ptr<ScriptValue> value = nullptr;
+    // (the first four are also the type ids of the default types)
+    enum Kind : unsigned char { NUL, NUMBER, STRING, NAME, OBJECT };
+    Kind kind = NUL;
+    bool shared = false; // STRING and NAME: long_text is used
+    ScriptTypeId object_type = 0; // OBJECT: the type id of "value"
+    union {
+        long double number;
+        std::string short_text;
+        ScriptText* long_text;
+    };
+    std::shared_ptr<const ScriptValue> value = nullptr; // OBJECT
 
     bool operator==(const ScriptVariable& sv) const {
-        return *sv.value == *value;
+        if(kind == OBJECT && sv.kind == OBJECT) {
+            return *sv.value == *value;
+        }
+        if(kind == OBJECT || sv.kind == OBJECT) {
+            std::unique_ptr<ScriptValue> l(box()), r(sv.box());
+            return *r == *l;
+        }
+        if(kind != sv.kind) return false;
+        if(kind == NUMBER) return number == sv.number;
+        if(kind == STRING || kind == NAME) {
+            return (shared && sv.shared && long_text == sv.long_text) || str() == sv.str();
+        }
+        return true;
     }
     
     ScriptVariable() {}
-    ScriptVariable(ScriptValue* ptr): value(ptr) {}
-    ScriptVariable(const ScriptVariable& var) {
-        if(var.value.get() != nullptr) value.reset(var.value->copy());
-    }
+    ScriptVariable(ScriptValue* ptr) { from(*this,ptr); }
+    ScriptVariable(long double num): kind(NUMBER), number(num) {}
+    ScriptVariable(const ScriptVariable& var) { assign(var); }
+    ScriptVariable(ScriptVariable&& var) noexcept { steal(var); }
+    ~ScriptVariable() { reset(); }
 
     template<typename _Tp>
     ScriptVariable(_Tp a) {
@@ -43,30 +115,167 @@ struct ScriptVariable {
         // the user can define other `from` functions inside the
         // `carescript` namespace to effectivly overload the
         // constructor of this class
-        from(*this,a);
+        from(*this,std::move(a));
     }
 
-    void operator=(const ScriptVariable& var) {
-        if(var.value.get() != nullptr) value.reset(var.value->copy());
+    // copy (or move) first, then swap: var may live inside what this
+    // variable owns, which must not be freed before var is read
+    ScriptVariable& operator=(const ScriptVariable& var) {
+        if(&var == this) return *this;
+        ScriptVariable copy(var);
+        swap(copy);
+        return *this;
+    }
+    ScriptVariable& operator=(ScriptVariable&& var) noexcept {
+        if(&var == this) return *this;
+        ScriptVariable moved(std::move(var));
+        swap(moved);
+        return *this;
+    }
+
+    void swap(ScriptVariable& var) noexcept {
+        ScriptVariable tmp;
+        tmp.steal(var);
+        var.steal(*this);
+        steal(tmp);
+    }
+
+    ScriptTypeId type_id() const {
+        return kind == OBJECT ? object_type : (ScriptTypeId)kind;
     }
 
     std::string get_type() const {
-        return value.get()->get_type();
+        switch(kind) {
+            case NUL: return "Null";
+            case NUMBER: return "Number";
+            case STRING: return "String";
+            case NAME: return "Name";
+            default: return value.get()->get_type();
+        }
     }
     std::string printable() const {
-        return value.get()->to_printable();
+        switch(kind) {
+            case NUL: return "null";
+            case NUMBER: return printable_number(number);
+            case STRING: case NAME: return str();
+            default: return value.get()->to_printable();
+        }
     }
     std::string string() const {
+        if(kind == STRING) return "\"" + str() + "\"";
+        if(kind != OBJECT) return printable();
         return value.get()->to_string();
     }
 
+    // the text of a STRING or NAME
+    const std::string& str() const {
+        return shared ? long_text->str : short_text;
+    }
+    // the value of an OBJECT to change in place, copied first if other
+    // variables (or a compiled constant) share it
+    ScriptValue& edit_value() {
+        if(value.use_count() > 1) value.reset(value->copy());
+        return const_cast<ScriptValue&>(*value);
+    }
+
+    // a heap allocated ScriptValue with the same value
+    ScriptValue* box() const {
+        switch(kind) {
+            case NUL: return new ScriptNullValue();
+            case NUMBER: return new ScriptNumberValue(number);
+            case STRING: return new ScriptStringValue(str());
+            case NAME: return new ScriptNameValue(str());
+            default: return value.get() == nullptr ? new ScriptNullValue() : value->copy();
+        }
+    }
+
     template<typename _Tp>
     operator _Tp() {
         return get_value<_Tp>(*this);
     }
 
+    // the default types are unpacked into the inline storage
     friend void from(ScriptVariable& var, ScriptValue* a) {
-        var.value.reset(a);
+        var.reset();
+        if(a == nullptr) return;
+        const std::type_info& type = typeid(*a);
+        if(type == typeid(ScriptNumberValue)) {
+            var.kind = NUMBER;
+            var.number = ((ScriptNumberValue*)a)->number;
+        }
+        else if(type == typeid(ScriptStringValue)) {
+            var.set_text(STRING,std::move(((ScriptStringValue*)a)->string));
+        }
+        else if(type == typeid(ScriptNameValue)) {
+            var.set_text(NAME,std::move(((ScriptNameValue*)a)->name));
+        }
+        else if(type != typeid(ScriptNullValue)) {
+            var.kind = OBJECT;
+            var.object_type = script_type_id(*a);
+            var.value.reset(a);
+            return;
+        }
+        delete a;
+    }
+
+    void set_text(Kind k, std::string str) {
+        reset();
+        // what fits into std::string's own buffer is copied, the rest shared
+        static const std::size_t short_size = std::string().capacity();
+        if(str.size() <= short_size) {
+            new (&short_text) std::string(std::move(str));
+        }
+        else {
+            long_text = new ScriptText{1,std::move(str)};
+            shared = true;
+        }
+        kind = k;
+    }
+private:
+    void reset() {
+        if(kind == STRING || kind == NAME) {
+            if(!shared) short_text.~basic_string();
+            else if(--long_text->refs == 0) delete long_text;
+        }
+        value.reset();
+        kind = NUL;
+        shared = false;
+    }
+    void assign(const ScriptVariable& var) {
+        switch(var.kind) {
+            case NUMBER: number = var.number; break;
+            case STRING: case NAME:
+                if(var.shared) {
+                    long_text = var.long_text;
+                    ++long_text->refs;
+                }
+                else new (&short_text) std::string(var.short_text);
+                break;
+            case OBJECT: value = var.value; break;
+            default: break;
+        }
+        kind = var.kind;
+        shared = var.shared;
+        object_type = var.object_type;
+    }
+    void steal(ScriptVariable& var) {
+        switch(var.kind) {
+            case NUMBER: number = var.number; break;
+            case STRING: case NAME:
+                if(var.shared) long_text = var.long_text;
+                else {
+                    new (&short_text) std::string(std::move(var.short_text));
+                    var.short_text.~basic_string();
+                }
+                break;
+            case OBJECT: value = std::move(var.value); break;
+            default: break;
+        }
+        kind = var.kind;
+        shared = var.shared;
+        object_type = var.object_type;
+        var.kind = NUL;
+        var.shared = false;
     }
 };
 
@@ -74,21 +283,18 @@ struct ScriptVariable {
 // checks if a variable has a specific type
 template<ScriptValueType _Tval>
 inline bool is_typeof(const carescript::ScriptVariable& var) {
-    _Tval inst;
-    return var.get_type() == inst.get_type();
+    return var.type_id() == script_type_id<_Tval>();
 }
 
 // checks if two subclasses of ScriptValue are the same
 template<ScriptValueType _Tp1, ScriptValueType _Tp2>
 inline bool is_same_type() {
-    _Tp1 v1;
-    _Tp2 v2;
-    return v1->get_type() == v2->get_type();
+    return script_type_id<_Tp1>() == script_type_id<_Tp2>();
 }
 
 // checks if two ScriptVariable instances have the same type
 inline bool is_same_type(const ScriptVariable& v1,const ScriptVariable& v2) {
-    return v1.get_type() == v2.get_type();
+    return v1.type_id() == v2.type_id();
 }
 
 // checks if a variable is null
@@ -97,9 +303,31 @@ inline bool is_null(const ScriptVariable& v) {
 }
 
 // returns the unwrapped type of a variable
+// (strings and names by reference, so they aren't copied).
+// A variable of another type gives the default of _Tp (0, "", or what a
+// default constructed _Tp holds), builtins that don't check their
+// arguments with cc_builtin_var_requires get that instead of a crash
 template<typename _Tp>
-inline auto get_value(const carescript::ScriptVariable& v) {
-    return ((const _Tp*)v.value.get())->get_value();
+inline decltype(auto) get_value(const carescript::ScriptVariable& v) {
+    if constexpr(std::is_same<_Tp,ScriptNumberValue>::value) {
+        if(v.kind == ScriptVariable::NUMBER) return v.number;
+        return (long double)0;
+    }
+    else if constexpr(std::is_same<_Tp,ScriptStringValue>::value || std::is_same<_Tp,ScriptNameValue>::value) {
+        static const std::string none;
+        if(v.kind == ScriptVariable::STRING || v.kind == ScriptVariable::NAME) return v.str();
+        return (none);
+    }
+    else if constexpr(std::is_same<_Tp,ScriptNullValue>::value) {
+        return;
+    }
+    else {
+        if(v.kind == ScriptVariable::OBJECT && v.object_type == script_type_id<_Tp>()) {
+            return ((const _Tp*)v.value.get())->get_value();
+        }
+        static const _Tp none;
+        return none.get_value();
+    }
 }
 
 const ScriptVariable script_null = new ScriptNullValue();
@@ -150,10 +378,119 @@ struct ScriptBuiltin {
     ScriptVariable(*exec)(const ScriptArglist&,ScriptSettings&);
 };
 
+// one instruction of a compiled expression
+struct ScriptOp {
+    enum Code : unsigned char {
+        PUSH,     // pushes constants[arg]
+        OPERATOR, // applies the overloads operators[arg] to the stack
+        CALL,     // pushes the result of calls[arg]
+        FAIL,     // stops with the error errors[arg]
+    } code;
+    unsigned int arg = 0;
+};
+
+struct ScriptCall;
+struct ScriptExpression;
+using ScriptExpressionPtr = std::shared_ptr<const ScriptExpression>;
+
+// an expression lexed and put into reverse polish order once, so
+// running it is a single pass over "ops" with a value stack.
+// Literals, operators and builtins are resolved when it's compiled
+struct ScriptExpression {
+    std::string source;
+    std::vector<ScriptOp> ops;
+    std::vector<ScriptVariable> constants;
+    std::vector<std::vector<ScriptOperator>> operators;
+    std::vector<ScriptCall> calls;
+    std::vector<std::string> errors;
+};
+
+// a builtin called inside of an expression, with its compiled arguments
+struct ScriptCall {
+    ScriptBuiltin builtin;
+    std::vector<ScriptExpressionPtr> args;
+};
+
+// one compiled line of a label: <builtin>(<arguments...>)
+struct ScriptLine {
+    std::string name;
+    bool known = false; // false if there was no builtin called "name"
+    ScriptBuiltin builtin;
+    std::vector<ScriptExpressionPtr> args;
+    unsigned long line = 0;
+};
+
+// a label's lines compiled to bytecode. Never changed once built, so
+// a running label can keep using it while a newer one replaces it
+struct ScriptCompiled {
+    std::size_t version = 0;
+    unsigned long invalid = 0; // the first line that isn't a builtin call
+    std::vector<ScriptLine> lines;
+};
+
+// a label's source and its latest compilation. Compiling depends on the
+// interpreter's builtins, operators, typechecks and macros, so it's
+// redone whenever they changed (see Interpreter::registry_version)
+struct ScriptProgram {
+    lexed_kittens tokens;
+    std::shared_ptr<const ScriptCompiled> compiled;
+};
+
+// compiled expressions by their source, so evaluating the same
+// expression again (or eval'ing the same script) skips lexing and
+// the shunting yard. Holds at most "capacity" expressions, dropping
+// the least recently used one, and forgets everything once the
+// registry_version it was filled with is outdated
+struct ScriptExpressionCache {
+    std::size_t capacity = 1024;
+
+    ScriptExpressionPtr find(const std::string& source, std::size_t registry_version) {
+        sync(registry_version);
+        auto found = index.find(source);
+        if(found == index.end()) return nullptr;
+        entries.splice(entries.begin(),entries,found->second);
+        return found->second->second;
+    }
+
+    void insert(const std::string& source, ScriptExpressionPtr expression, std::size_t registry_version) {
+        sync(registry_version);
+        if(capacity == 0) return;
+        auto found = index.find(source);
+        if(found != index.end()) {
+            found->second->second = expression;
+            entries.splice(entries.begin(),entries,found->second);
+            return;
+        }
+        entries.emplace_front(source,expression);
+        index[source] = entries.begin();
+        while(entries.size() > capacity) {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+
+    void clear() {
+        index.clear();
+        entries.clear();
+    }
+
+    std::size_t size() const { return entries.size(); }
+private:
+    std::size_t version = 0;
+    std::list<std::pair<std::string,ScriptExpressionPtr>> entries;
+    std::unordered_map<std::string,std::list<std::pair<std::string,ScriptExpressionPtr>>::iterator> index;
+
+    void sync(std::size_t registry_version) {
+        if(version == registry_version) return;
+        clear();
+        version = registry_version;
+    }
+};
+
 // storage class for a label
 struct ScriptLabel {
     std::vector<std::string> arglist;
-    lexed_kittens lines;
+    std::shared_ptr<ScriptProgram> program;
     int line = 0;
 };
 
@@ -170,13 +507,25 @@ bool bake_extension(Extension* extension, ScriptSettings& settings);
 // runs a "main" function of a script
 std::string run_script(std::string source, ScriptSettings& settings);
 // runs a specific label with the given parameters
-std::string run_label(std::string label_name, std::map<std::string,ScriptLabel> labels, ScriptSettings& settings, std::filesystem::path parent_path , std::vector<ScriptVariable> args);
+std::string run_label(std::string label_name, const std::map<std::string,ScriptLabel>& labels, ScriptSettings& settings, std::filesystem::path parent_path , std::vector<ScriptVariable> args);
 
 // preprocesses the file into the interpreter
 std::map<std::string,ScriptLabel> pre_process(std::string source, ScriptSettings& settings);
 std::vector<ScriptVariable> parse_argumentlist(std::string source, ScriptSettings& settings);
 // evaluates an expression and returns the result
 ScriptVariable evaluate_expression(std::string source, ScriptSettings& settings);
+
+// compiles the lines of a label
+std::shared_ptr<const ScriptCompiled> compile_label(const ScriptProgram& program, ScriptSettings& settings);
+// compiles an argument list "(...)" and an expression
+std::vector<ScriptExpressionPtr> compile_argumentlist(std::string source, ScriptSettings& settings);
+ScriptExpression compile_expression(std::string source, ScriptSettings& settings);
+// the compiled expression from the interpreter's cache, compiling it
+// on a miss
+ScriptExpressionPtr cached_expression(const std::string& source, ScriptSettings& settings);
+// runs compiled arguments and expressions
+std::vector<ScriptVariable> run_argumentlist(const std::vector<ScriptExpressionPtr>& args, ScriptSettings& settings);
+ScriptVariable run_expression(const ScriptExpression& expression, ScriptSettings& settings);
 void parse_const_preprog(std::string source, ScriptSettings& settings);
 
 class Interpreter;
@@ -224,6 +573,16 @@ public:
     std::vector<ScriptTypeCheck> script_typechecks = default_script_typechecks;
     std::unordered_map<std::string,std::string> script_macros;
     ScriptSettings settings = ScriptSettings(*this);
+    // bumped on every change to the four lists above, so that compiled
+    // labels get recompiled. Bump it after changing them directly
+    std::size_t registry_version = 1;
+    ScriptExpressionCache expression_cache;
+    // set when the process must outlive the script (e.g. a server running
+    // scripts): exit() then ends the script and leaves its status here
+    // instead of ending the process
+    bool hosted = false;
+    bool exited = false;
+    int exit_status = 0;
 
     void save(int id) {
         states[id].save(*this);
@@ -234,6 +593,7 @@ public:
     }
 
     void clear() {
+        ++registry_version;
         script_builtins.clear();
         script_operators.clear();
         script_typechecks.clear();
@@ -287,18 +647,22 @@ public:
     std::string error() const { return settings.error_msg; }
 
     Interpreter& add_builtin(std::string name, const ScriptBuiltin& builtin) {
+        ++registry_version;
         script_builtins[name] = builtin;
         return *this;
     }
     Interpreter& add_operator(std::string name, const ScriptOperator& _operator) {
+        ++registry_version;
         script_operators[name].push_back(_operator);
         return *this;
     }
     Interpreter& add_typecheck(const ScriptTypeCheck& typecheck) {
+        ++registry_version;
         script_typechecks.push_back(typecheck);
         return *this;
     }
     Interpreter& add_macro(std::string macro, std::string replacement) {
+        ++registry_version;
         script_macros[macro] = replacement;
         return *this;
     }
@@ -389,10 +753,10 @@ template<typename _Tp>
 concept IntegralType = std::is_integral<_Tp>::value;
 template<IntegralType _Tp>
 void from(carescript::ScriptVariable& var, _Tp i) {
-    var = new carescript::ScriptNumberValue(i);
+    var = carescript::ScriptVariable((long double)i);
 }
-void from(carescript::ScriptVariable& var, std::string i) {
-    var = new carescript::ScriptStringValue(i);
+inline void from(carescript::ScriptVariable& var, std::string i) {
+    var.set_text(carescript::ScriptVariable::STRING,std::move(i));
 }
 
 } /* namespace carescript */
@@ -25,7 +25,7 @@
         auto _rg = (variable); \
         _cc_error("argument " #variable " is not allowed to match any of these types: "  _cc_chain(__VA_ARGS__) " (got: " + ((_rg)).get_type() + ")"); \
     } else do {} while (0)
-#define cc_builtin_same_type(variable1, variable2) if((variable1).get_type() != (variable2).get_type()) {\
+#define cc_builtin_same_type(variable1, variable2) if(!is_same_type((variable1),(variable2))) {\
         auto _rg1 = (variable1); \
         auto _rg2 = (variable2); \
         _cc_error(#variable1 " and "#variable2 " must have the same type (" #variable1 ": " + (_rg1).get_type() + " | " #variable2 ": " + (_rg2).get_type() + ")");\
@@ -45,7 +45,7 @@
     if(_cc_eval(_cc_requires1(variable, __VA_ARGS__))) { \
         _cc_error(op ": " #variable " doesn't match any of these types: "  _cc_chain(__VA_ARGS__) " (got: " + (variable).get_type() + ")"); \
     } else do {} while (0)
-#define cc_operator_same_type(variable1, variable2, op) if((variable1).get_type() != (variable2).get_type()) {\
+#define cc_operator_same_type(variable1, variable2, op) if(!is_same_type((variable1),(variable2))) {\
         _cc_error(#op ": " #variable1 " and "#variable2 " must have the same type (" #variable1 ": " + (variable1).get_type() + " | " #variable2 ": " + (variable2).get_type() + ")");\
     } else do {} while (0)
 #define _cc_requires1(variable, type1, ...) _cc_second(__VA_OPT__(,) _cc_requires2(variable, type1, __VA_ARGS__), _cc_requires3(variable, type1))
@@ -52,6 +52,7 @@ inline bool bake_extension(Extension* ext, ScriptSettings& settings) {
     }
     MacroList m_list = ext->get_macros();
     settings.interpreter.script_macros.insert(m_list.begin(),m_list.end());
+    ++settings.interpreter.registry_version;
     return true;
 }
 
@@ -64,56 +65,65 @@ inline std::string run_script(std::string source,ScriptSettings& settings) {
     return ret;
 }
 
-inline std::string run_label(std::string label_name, std::map<std::string,ScriptLabel> labels, ScriptSettings& settings, std::filesystem::path parent_path, std::vector<ScriptVariable> args) {
-    if(labels.empty() || labels.count(label_name) == 0) return "";
-    ScriptLabel label = labels[label_name];
-    std::vector<lexed_kittens> lines;
-    int line = -1;
-    for(auto i : label.lines) {
-        if(i.line != line) {
-            line = i.line;
-            lines.push_back({});
-        }
-        lines.back().push_back(i);
+inline std::string run_label(std::string label_name, const std::map<std::string,ScriptLabel>& labels, ScriptSettings& settings, std::filesystem::path parent_path, std::vector<ScriptVariable> args) {
+    auto found = labels.find(label_name);
+    if(found == labels.end() || found->second.program == nullptr) return "";
+    ScriptLabel label = found->second;
+    ScriptProgram& program = *label.program;
+    // this frame keeps its own compilation alive: a nested call may
+    // recompile the label while we're still running its lines
+    std::shared_ptr<const ScriptCompiled> compiled = program.compiled;
+    if(compiled == nullptr || compiled->version != settings.interpreter.registry_version) {
+        compiled = program.compiled = compile_label(program,settings);
+    }
+    if(compiled->invalid != 0) {
+        return "line " + std::to_string(compiled->invalid-1 + label.line) + " is invalid (in label " + label_name + ")";
     }
     settings.label.push(label_name);
-    for(auto i : lines) 
-        if(i.size() != 2 || i[0].str || i[1].str || i[1].src.front() != '(') { 
-            settings.label.pop();
-            return "line " + std::to_string(i.front().line-1 + label.line) + " is invalid (in label " + label_name + ")"; 
-        }
 
     settings.parent_path = parent_path;
     settings.labels = labels;
 
     for(size_t i = 0; i < args.size(); ++i) {
-        settings.variables[label.arglist[i]] = args[i];
+        settings.variables[label.arglist[i]] = std::move(args[i]);
     }
     if(settings.line == 0) settings.line = 1;
-    for(size_t i = settings.line-1; i < lines.size(); ++i) {
-        if(settings.exit) return "";
+    for(size_t i = settings.line-1; i < compiled->lines.size(); ++i) {
+        if(settings.exit || settings.interpreter.exited) return "";
         i = settings.line-1;
-        std::string name = lines[i][0].src;
-        auto arglist = parse_argumentlist(lines[i][1].src,settings);
+        // a builtin (like bake) may have changed what the lines compile to
+        if(compiled->version != settings.interpreter.registry_version) {
+            if(program.compiled->version != settings.interpreter.registry_version) {
+                program.compiled = compile_label(program,settings);
+            }
+            compiled = program.compiled;
+            if(compiled->invalid != 0) {
+                settings.label.pop();
+                return "line " + std::to_string(compiled->invalid-1 + label.line) + " is invalid (in label " + label_name + ")";
+            }
+        }
+        const ScriptLine& line = compiled->lines[i];
+        auto arglist = run_argumentlist(line.args,settings);
+        // exit() in a label called by one of the arguments
+        if(settings.interpreter.exited) return "";
         if(settings.error_msg != "") {
             settings.label.pop();
             if(settings.raw_error) return settings.error_msg;
             return "line " + std::to_string(settings.line + label.line) + ": " + settings.error_msg + " (in label " + label_name + ")";
         }
-        if(settings.interpreter.script_builtins.count(name) == 0) {
+        if(!line.known) {
             settings.label.pop();
-            return "line " + std::to_string(settings.line + label.line) + ": unknown function: " + name + " (in label " + label_name + ")";
+            return "line " + std::to_string(settings.line + label.line) + ": unknown function: " + line.name + " (in label " + label_name + ")";
         }
-        ScriptBuiltin builtin = settings.interpreter.script_builtins[name];
-        if(builtin.arg_count != arglist.size() && builtin.arg_count >= 0) {
+        if(line.builtin.arg_count >= 0 && (size_t)line.builtin.arg_count != arglist.size()) {
             settings.label.pop();
-            return "line " + std::to_string(lines[i][0].line + label.line) + " " + name + " has invalid argument count " + " (in label " + label_name + ")";
+            return "line " + std::to_string(line.line + label.line) + " " + line.name + " has invalid argument count " + " (in label " + label_name + ")";
         }
-        builtin.exec(arglist,settings);
+        line.builtin.exec(arglist,settings);
         if(settings.error_msg != "") {
             settings.label.pop();
             if(settings.raw_error) return settings.error_msg;
-            return "line " + std::to_string(settings.line + label.line) + ": " + name + ": " + settings.error_msg + " (in label " + label_name + ")";
+            return "line " + std::to_string(settings.line + label.line) + ": " + line.name + ": " + settings.error_msg + " (in label " + label_name + ")";
         }
         ++settings.line;
     }
@@ -121,6 +131,41 @@ inline std::string run_label(std::string label_name, std::map<std::string,Script
     return "";
 }
 
+inline std::shared_ptr<const ScriptCompiled> compile_label(const ScriptProgram& program, ScriptSettings& settings) {
+    auto compiled = std::make_shared<ScriptCompiled>();
+    compiled->version = settings.interpreter.registry_version;
+
+    std::vector<lexed_kittens> lines;
+    unsigned long line = 0;
+    for(auto& i : program.tokens) {
+        if(lines.empty() || i.line != line) {
+            line = i.line;
+            lines.push_back({});
+        }
+        lines.back().push_back(i);
+    }
+    for(auto& i : lines) {
+        if(i.size() != 2 || i[0].str || i[1].str || i[1].src.front() != '(') {
+            compiled->invalid = i.front().line;
+            return compiled;
+        }
+    }
+
+    for(auto& i : lines) {
+        ScriptLine compiled_line;
+        compiled_line.name = i[0].src;
+        compiled_line.line = i[0].line;
+        auto builtin = settings.interpreter.script_builtins.find(compiled_line.name);
+        if(builtin != settings.interpreter.script_builtins.end()) {
+            compiled_line.known = true;
+            compiled_line.builtin = builtin->second;
+        }
+        compiled_line.args = compile_argumentlist(i[1].src,settings);
+        compiled->lines.push_back(std::move(compiled_line));
+    }
+    return compiled;
+}
+
 inline static bool is_operator_char(char c) {
     return c == '+' ||
            c == '-' ||
@@ -207,7 +252,7 @@ inline static std::vector<std::string> parse_label_arglist(std::string s) {
     return ret;
 }
 
-inline std::vector<ScriptVariable> parse_argumentlist(std::string source, ScriptSettings& settings) {
+inline std::vector<ScriptExpressionPtr> compile_argumentlist(std::string source, ScriptSettings& settings) {
     KittenLexer arg_lexer = KittenLexer()
         .add_capsule('(',')')
         .add_capsule('[',']')
@@ -225,7 +270,7 @@ inline std::vector<ScriptVariable> parse_argumentlist(std::string source, Script
     source.pop_back();
 
     auto lexed = arg_lexer.lex(source);
-    if(lexed.empty()) return std::vector<ScriptVariable>{};
+    if(lexed.empty()) return {};
     std::vector<std::string> args(1);
     for(auto i : lexed) {
         if(!i.str && i.src == ",") {
@@ -239,34 +284,47 @@ inline std::vector<ScriptVariable> parse_argumentlist(std::string source, Script
         }
     }
 
+    std::vector<ScriptExpressionPtr> ret;
+    for(auto& i : args) {
+        ret.push_back(cached_expression(i,settings));
+    }
+    return ret;
+}
+
+inline std::vector<ScriptVariable> run_argumentlist(const std::vector<ScriptExpressionPtr>& args, ScriptSettings& settings) {
     std::vector<ScriptVariable> ret;
-    for(auto i : args) {
-        ret.push_back(evaluate_expression(i,settings));
+    ret.reserve(args.size());
+    for(auto& i : args) {
+        ret.push_back(run_expression(*i,settings));
         if(settings.error_msg != "") return {};
     }
     return ret;
 }
 
+inline std::vector<ScriptVariable> parse_argumentlist(std::string source, ScriptSettings& settings) {
+    return run_argumentlist(compile_argumentlist(source,settings),settings);
+}
+
 inline static bool is_operator(std::string src, ScriptSettings& settings) {
     return settings.interpreter.script_operators.count(src) != 0;
 }
 
-inline static void process_op(std::stack<ScriptVariable>& st, std::vector<ScriptOperator> ops, ScriptSettings& settings) {
+inline static void process_op(std::vector<ScriptVariable>& st, const std::vector<ScriptOperator>& ops, ScriptSettings& settings) {
     ScriptVariable v;
-    ScriptVariable r = st.top(); st.pop();
+    ScriptVariable r = std::move(st.back()); st.pop_back();
     ScriptVariable l = script_null;
     std::vector<std::string> error_msgs;
     if(st.empty()) {
-        l = r;
+        l = std::move(r);
         r = script_null;
     }
-    else l = st.top();
+    else l = st.back();
     for(int i = 0; i < ops.size(); ++i) {
-        ScriptOperator op = ops[i];
+        const ScriptOperator& op = ops[i];
         if(op.type == op.UNARY) {
             v = op.run_unary(l,settings);
             if(!is_null(v)) {
-                st.push(v);
+                st.push_back(std::move(v));
                 return;
             }
             else {
@@ -276,11 +334,9 @@ inline static void process_op(std::stack<ScriptVariable>& st, std::vector<Script
         } 
         else {
             if(r == script_null) continue;
-            ScriptVariable l = st.top();
             v = op.run(l,r,settings);
             if(!is_null(v)) {
-                st.pop();
-                st.push(v);
+                st.back() = std::move(v);
                 return;
             }
             else {
@@ -295,7 +351,10 @@ inline static void process_op(std::stack<ScriptVariable>& st, std::vector<Script
     }
 }
 
-inline ScriptVariable evaluate_expression(std::string source, ScriptSettings& settings) {
+// the shunting yard part of evaluating an expression only depends on
+// its tokens, so it's done here once: "ops" gets the literals, calls
+// and operators in the order they would be evaluated in
+inline ScriptExpression compile_expression(std::string source, ScriptSettings& settings) {
     KittenLexer expression_lexer = KittenLexer()
         .add_stringq('"')
         .add_capsule('(',')')
@@ -310,63 +369,114 @@ inline ScriptVariable evaluate_expression(std::string source, ScriptSettings& se
         .erase_empty();
     auto lexed = expression_lexer.lex(source);
 
-    ScriptVariable ret;
-
-    std::stack<ScriptVariable> stack;
-    std::stack<std::vector<ScriptOperator>> ops;
+    ScriptExpression ret;
+    ret.source = source;
+    auto emit = [&](ScriptOp::Code code, unsigned int arg) {
+        ret.ops.push_back(ScriptOp{code,arg});
+    };
 
+    std::vector<unsigned int> ops;
     bool may_be_unary = true;
     for(size_t i = 0; i < lexed.size(); ++i) {
         if(!lexed[i].str && is_operator(lexed[i].src,settings)) {
-            std::vector<ScriptOperator> opss = settings.interpreter.script_operators[lexed[i].src];
+            const std::vector<ScriptOperator>& opss = settings.interpreter.script_operators[lexed[i].src];
             ScriptOperator cur_op = opss[0];
             if(may_be_unary && cur_op.type != cur_op.BOTH) cur_op.type = cur_op.UNARY;
             else cur_op.type = cur_op.DOUBLE;
             while (!ops.empty() && (
-                    (cur_op.type == cur_op.DOUBLE && ops.top()[0].priority >= cur_op.priority) ||
-                    (cur_op.type == cur_op.UNARY && ops.top()[0].priority > cur_op.priority)
+                    (cur_op.type == cur_op.DOUBLE && ret.operators[ops.back()][0].priority >= cur_op.priority) ||
+                    (cur_op.type == cur_op.UNARY && ret.operators[ops.back()][0].priority > cur_op.priority)
                 )) {
-                process_op(stack, ops.top(),settings);
-                if(settings.error_msg != "") return script_null;
-                ops.pop();
+                emit(ScriptOp::OPERATOR,ops.back());
+                ops.pop_back();
             }
-            ops.push(opss);
+            ops.push_back(ret.operators.size());
+            ret.operators.push_back(opss);
             may_be_unary = true;
         } 
         else {
+            // a builtin's name followed by its argument list
             if(!lexed[i].str && lexed[i].src.front() == '(' && 
-                !stack.empty() && is_typeof<ScriptNameValue>(stack.top())
-                && settings.interpreter.script_builtins.count(get_value<ScriptNameValue>(stack.top())) != 0) {
-                
-                auto builtin = settings.interpreter.script_builtins[get_value<ScriptNameValue>(stack.top())];
-                stack.pop();
-                auto r = builtin.exec(parse_argumentlist(lexed[i].src,settings),settings);
-                if(settings.error_msg != "") { 
-                    return script_null;
-                }
-                stack.push(r);
+                !ret.ops.empty() && ret.ops.back().code == ScriptOp::PUSH &&
+                is_typeof<ScriptNameValue>(ret.constants[ret.ops.back().arg]) &&
+                settings.interpreter.script_builtins.count(get_value<ScriptNameValue>(ret.constants[ret.ops.back().arg])) != 0) {
+
+                std::string name = get_value<ScriptNameValue>(ret.constants[ret.ops.back().arg]);
+                ret.constants.pop_back();
+                ret.ops.back() = ScriptOp{ScriptOp::CALL,(unsigned int)ret.calls.size()};
+                ret.calls.push_back(ScriptCall{settings.interpreter.script_builtins[name],compile_argumentlist(lexed[i].src,settings)});
             }
             else {
-                if(!valid_literal(lexed[i],settings)) {
-                    settings.error_msg = "invalid literal: " + lexed[i].src;
-                    return script_null;
+                ScriptValue* literal = nullptr;
+                for(auto check : settings.interpreter.script_typechecks) {
+                    literal = check(lexed[i],settings);
+                    if(literal != nullptr) break;
+                }
+                if(literal == nullptr) {
+                    emit(ScriptOp::FAIL,ret.errors.size());
+                    ret.errors.push_back("invalid literal: " + lexed[i].src);
+                    return ret;
                 }
-                stack.push(to_var(lexed[i],settings));
+                emit(ScriptOp::PUSH,ret.constants.size());
+                ret.constants.push_back(ScriptVariable(literal));
             }
             may_be_unary = false;
         }
     }
 
     while (!ops.empty()) {
-        process_op(stack, ops.top(),settings);
-        if(settings.error_msg != "") return script_null;
-        ops.pop();
+        emit(ScriptOp::OPERATOR,ops.back());
+        ops.pop_back();
+    }
+    return ret;
+}
+
+inline ScriptVariable run_expression(const ScriptExpression& expression, ScriptSettings& settings) {
+    std::vector<ScriptVariable> stack;
+    stack.reserve(expression.ops.size());
+    for(auto op : expression.ops) {
+        switch(op.code) {
+        case ScriptOp::PUSH:
+            stack.push_back(expression.constants[op.arg]);
+            break;
+        case ScriptOp::OPERATOR:
+            if(stack.empty()) break;
+            process_op(stack,expression.operators[op.arg],settings);
+            if(settings.error_msg != "") return script_null;
+            break;
+        case ScriptOp::CALL: {
+            const ScriptCall& call = expression.calls[op.arg];
+            auto args = run_argumentlist(call.args,settings);
+            if(settings.error_msg != "") return script_null;
+            stack.push_back(call.builtin.exec(args,settings));
+            if(settings.error_msg != "") return script_null;
+            break;
+        }
+        case ScriptOp::FAIL:
+            settings.error_msg = expression.errors[op.arg];
+            return script_null;
+        }
     }
+
     if(stack.size() != 1) {
-        settings.error_msg = "invalid expression: \"" + source + "\"";
+        settings.error_msg = "invalid expression: \"" + expression.source + "\"";
         return script_null; 
     }
-    return stack.top();
+    return std::move(stack.back());
+}
+
+inline ScriptExpressionPtr cached_expression(const std::string& source, ScriptSettings& settings) {
+    Interpreter& interpreter = settings.interpreter;
+    ScriptExpressionPtr expression = interpreter.expression_cache.find(source,interpreter.registry_version);
+    if(expression == nullptr) {
+        expression = std::make_shared<const ScriptExpression>(compile_expression(source,settings));
+        interpreter.expression_cache.insert(source,expression,interpreter.registry_version);
+    }
+    return expression;
+}
+
+inline ScriptVariable evaluate_expression(std::string source, ScriptSettings& settings) {
+    return run_expression(*cached_expression(source,settings),settings);
 }
 
 inline void parse_const_preprog(std::string source, ScriptSettings& settings) {
@@ -436,6 +546,7 @@ inline std::map<std::string,ScriptLabel> pre_process(std::string source, ScriptS
         lines.back().push_back(i);
     }
 
+    std::map<std::string,lexed_kittens> tokens;
     std::string current_label = "main";
     for(size_t i = 0; i < lines.size(); ++i) {
         auto& line = lines[i];
@@ -514,6 +625,7 @@ inline std::map<std::string,ScriptLabel> pre_process(std::string source, ScriptS
                 current_label = line[1].src;
                 ret[current_label].arglist = parse_label_arglist(line[2].src);
                 ret[current_label].line = line[1].line;
+                tokens[current_label];
             }
             else {
                 settings.error_msg = "line " + std::to_string(i+1) + ": invalid pre processor instruction: no match for: " + inst;
@@ -521,10 +633,16 @@ inline std::map<std::string,ScriptLabel> pre_process(std::string source, ScriptS
             }
         }
         else {
-            for(auto j : line) ret[current_label].lines.push_back(j);
+            for(auto j : line) tokens[current_label].push_back(j);
         }
     }
 
+    for(auto& i : tokens) {
+        auto program = std::make_shared<ScriptProgram>();
+        program->tokens = std::move(i.second);
+        program->compiled = compile_label(*program,settings);
+        ret[i.first].program = program;
+    }
     return ret;
 }
 
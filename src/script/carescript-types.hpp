@@ -20,6 +20,14 @@ struct ScriptValue {
     virtual ~ScriptValue() {};
 };
 
+// how numbers are printed: without trailing zeros
+inline std::string printable_number(long double number) {
+    std::string str = std::to_string(number);
+    str.erase(str.find_last_not_of('0') + 1, std::string::npos);
+    str.erase(str.find_last_not_of('.') + 1, std::string::npos);
+    return str;
+}
+
 // default number type implementation
 struct ScriptNumberValue : public ScriptValue {
     const std::string get_type() const override { return "Number"; }
@@ -30,10 +38,7 @@ struct ScriptNumberValue : public ScriptValue {
     }
 
     std::string to_printable() const override {
-        std::string str = std::to_string(number);
-        str.erase(str.find_last_not_of('0') + 1, std::string::npos);
-        str.erase(str.find_last_not_of('.') + 1, std::string::npos);
-        return str;
+        return printable_number(number);
     }
     std::string to_string() const override {
         return to_printable();
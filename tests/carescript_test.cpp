@@ -0,0 +1,390 @@
+/** tests of the carescript interpreter in src/script: scripts run through
+    the compiled labels and the expression cache, and the ScriptVariable
+    value type underneath. Prints every failed check and exits with 1 if
+    there was one:
+
+    make test
+
+    Extensions are baked in-process here (bake_extension with an Extension
+    object) instead of being loaded from a shared library. */
+#include <cstdio>
+#include <string>
+
+#include "script/carescript-api.hpp"
+
+using namespace std;
+using namespace carescript;
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            ++failures; \
+            printf("%s:%d: failed: %s\n", __FILE__, __LINE__, #cond); \
+        } \
+    } while (0)
+
+/** a fresh interpreter that has run "source", errors are in error() */
+static void runScript(Interpreter& interp, const string& source)
+{
+    interp.pre_process(source);
+    if (interp.error().empty())
+        interp.run();
+}
+
+/** the number in variable "name", NaN if it's not a number */
+static long double number(Interpreter& interp, const string& name)
+{
+    const ScriptVariable& var = interp.settings.variables[name];
+    if (!is_typeof<ScriptNumberValue>(var))
+        return 0.0L / 0.0L;
+    return get_value<ScriptNumberValue>(var);
+}
+
+static string text(Interpreter& interp, const string& name)
+{
+    return interp.settings.variables[name].printable();
+}
+
+/** an extension with the builtin twice(n) and the operator "a times b" */
+struct TwiceExtension : Extension
+{
+    BuiltinList get_builtins() override
+    {
+        return { { "twice", { 1, [](const ScriptArglist& args, ScriptSettings& settings) -> ScriptVariable {
+            cc_builtin_if_ignore();
+            cc_builtin_var_requires(args[0], ScriptNumberValue);
+            return ScriptVariable(get_value<ScriptNumberValue>(args[0]) * 2);
+        } } } };
+    }
+    OperatorList get_operators() override
+    {
+        return { { "times", { { 1, ScriptOperator::DOUBLE, [](ScriptVariable left, ScriptVariable right, ScriptSettings& settings) -> ScriptVariable {
+            cc_operator_same_type(right, left, "times");
+            cc_operator_var_requires(right, "times", ScriptNumberValue);
+            return ScriptVariable(get_value<ScriptNumberValue>(left) * get_value<ScriptNumberValue>(right));
+        }, nullptr } } } };
+    }
+    MacroList get_macros() override { return {}; }
+    TypeList get_types() override { return {}; }
+};
+
+static TwiceExtension twiceExtension;
+
+/** a type of an extension: a color like red */
+struct ColorValue : ScriptValue
+{
+    string color;
+
+    ColorValue(string color = "") : color(color) { }
+    const string get_type() const override { return "Color"; }
+    bool operator==(const ScriptValue* value) const override
+    {
+        return value->get_type() == get_type() && ((const ColorValue*)value)->color == color;
+    }
+    string to_printable() const override { return "#" + color; }
+    string to_string() const override { return to_printable(); }
+    ScriptValue* copy() const override { return new ColorValue(color); }
+    string get_value() const { return color; }
+};
+
+/** a type holding other variables, to assign a variable what it owns */
+struct ListValue : ScriptValue
+{
+    vector<ScriptVariable> items;
+
+    const string get_type() const override { return "List"; }
+    bool operator==(const ScriptValue* value) const override
+    {
+        return value->get_type() == get_type() && ((const ListValue*)value)->items == items;
+    }
+    string to_printable() const override { return "list"; }
+    string to_string() const override { return to_printable(); }
+    ScriptValue* copy() const override
+    {
+        ListValue* list = new ListValue();
+        list->items = items;
+        return list;
+    }
+};
+
+/** half(n) doesn't check that it got a number */
+static ScriptBuiltin uncheckedHalf = { 1, [](const ScriptArglist& args, ScriptSettings& settings) -> ScriptVariable {
+    cc_builtin_if_ignore();
+    return ScriptVariable(get_value<ScriptNumberValue>(args[0]) / 2);
+} };
+
+/** bake_twice() bakes TwiceExtension, like bake("...") bakes a library */
+static ScriptBuiltin bakeTwice = { 0, [](const ScriptArglist&, ScriptSettings& settings) -> ScriptVariable {
+    cc_builtin_if_ignore();
+    return bake_extension(&twiceExtension, settings) ? script_true : script_false;
+} };
+
+/** if/else/endif and labels (call, return, arguments) on compiled lines */
+static void testControlFlow()
+{
+    const string source =
+        "set(a, \"none\")\n"
+        "if(1 is 1)\n"
+        "set(a, \"then\")\n"
+        "else()\n"
+        "set(a, \"else\")\n"
+        "endif()\n"
+        "set(b, \"none\")\n"
+        "if(1 is 2)\n"
+        "set(b, \"then\")\n"
+        "if(1)\n"
+        "set(b, \"nested\")\n"
+        "endif()\n"
+        "else()\n"
+        "set(b, \"else\")\n"
+        "endif()\n"
+        "set(r, call(sum, 20, 22))\n"
+        "set(f, call(count, 4))\n"
+        "@sum [x,y]\n"
+        "return($x + call(id, $y))\n"
+        "@id [v]\n"
+        "return($v)\n"
+        "@count [n]\n"
+        "set(m, 0)\n"
+        "if($n more 0)\n"
+        "set(m, call(count, $n - 1))\n"
+        "endif()\n"
+        "return($m + 1)\n";
+
+    Interpreter interp;
+    runScript(interp, source);
+    CHECK(interp.error() == "");
+    CHECK(text(interp, "a") == "then");
+    CHECK(text(interp, "b") == "else");
+    CHECK(number(interp, "r") == 42);
+    CHECK(number(interp, "f") == 5);
+
+    /** the compiled lines are reused by a second run (reset like pie does
+        between daemon requests) */
+    interp.settings.variables.clear();
+    interp.settings.exit = false;
+    interp.settings.line = 0;
+    interp.run();
+    CHECK(interp.error() == "");
+    CHECK(number(interp, "f") == 5);
+
+    /** errors still point at the line of the label */
+    Interpreter bad;
+    runScript(bad, "set(x, 1)\nnosuch(1)\n");
+    CHECK(bad.error().find("unknown function: nosuch") != string::npos);
+}
+
+/** a label recompiled (by bake) while outer calls of it still run its lines */
+static void testRecompileWhileRunning()
+{
+    const string source =
+        "set(x, call(h, 1))\n"
+        "@h [n]\n"
+        "if($n is 0)\n"
+        "bake_twice()\n"
+        "endif()\n"
+        "if($n is 1)\n"
+        "set(r, call(both, call(h, 0), call(h, 0)))\n"
+        "endif()\n"
+        "return(twice($n))\n"
+        "@both [a,b]\n"
+        "return(1)\n";
+
+    Interpreter interp;
+    interp.add_builtin("bake_twice", bakeTwice);
+    runScript(interp, source);
+    CHECK(interp.error() == "");
+    CHECK(number(interp, "x") == 2);
+}
+
+/** expressions and lines cached before a bake see what it added */
+static void testCacheAfterBake()
+{
+    const string source = "set(x, twice(4))\nset(y, 2 times 3)\n";
+
+    Interpreter interp;
+    interp.eval(source);
+    CHECK(interp.error() != "");
+    interp.settings.error_msg = "";
+    interp.settings.line = 0;
+    interp.eval("set(y, 2 times 3)\n");
+    CHECK(interp.error() != "");
+    CHECK(interp.expression_cache.size() != 0);
+
+    size_t version = interp.registry_version;
+    CHECK(bake_extension(&twiceExtension, interp.settings));
+    CHECK(interp.registry_version != version);
+
+    interp.settings.error_msg = "";
+    interp.settings.line = 0;
+    interp.eval(source);
+    CHECK(interp.error() == "");
+    CHECK(number(interp, "x") == 8);
+    CHECK(number(interp, "y") == 6);
+
+    /** and a program compiled before the bake is compiled again */
+    Interpreter compiled;
+    compiled.pre_process(source);
+    CHECK(compiled.error() == "");
+    bake_extension(&twiceExtension, compiled.settings);
+    compiled.run();
+    CHECK(compiled.error() == "");
+    CHECK(number(compiled, "x") == 8);
+    CHECK(number(compiled, "y") == 6);
+}
+
+/** get_value of a variable of another type gives the type's default */
+static void testMistypedValues()
+{
+    ScriptVariable two(2.0L), text = new ScriptStringValue("text"),
+                   color = new ColorValue("red"), null;
+    CHECK(get_value<ScriptNumberValue>(text) == 0);
+    CHECK(get_value<ScriptNumberValue>(color) == 0);
+    CHECK(get_value<ScriptStringValue>(two) == "");
+    CHECK(get_value<ScriptNameValue>(color) == "");
+    CHECK(get_value<ColorValue>(two) == "");
+    CHECK(get_value<ColorValue>(text) == "");
+    CHECK(get_value<ColorValue>(null) == "");
+    CHECK(get_value<ColorValue>(color) == "red");
+
+    /** a builtin that doesn't check what it got */
+    Interpreter interp;
+    interp.add_builtin("half", uncheckedHalf);
+    runScript(interp, "set(a, half(7))\nset(b, half(\"x\"))\nset(c, half(b))\n");
+    CHECK(interp.error() == "");
+    CHECK(number(interp, "a") == 3.5);
+    CHECK(number(interp, "b") == 0);
+    CHECK(number(interp, "c") == 0);
+
+    /** and one that does */
+    Interpreter checked;
+    runScript(checked, "if(\"x\")\nendif()\n");
+    CHECK(checked.error().find("does match any of these types: Number") != string::npos);
+}
+
+/** copies and moves of "expected", each must still equal it */
+static void checkCopies(const ScriptVariable& expected)
+{
+    ScriptVariable copy(expected);
+    CHECK(copy == expected);
+    CHECK(copy.get_type() == expected.get_type());
+    CHECK(copy.printable() == expected.printable());
+
+    ScriptVariable assigned(2.0L);
+    assigned = expected;
+    CHECK(assigned == expected);
+    assigned = assigned;
+    CHECK(assigned == expected);
+    ScriptVariable& same = assigned;
+    assigned = std::move(same);
+    CHECK(assigned == expected);
+
+    ScriptVariable moved(std::move(copy));
+    CHECK(moved == expected);
+    ScriptVariable moveAssigned = new ScriptStringValue(string(100, 'o'));
+    moveAssigned = std::move(moved);
+    CHECK(moveAssigned == expected);
+    CHECK(moveAssigned.get_type() == expected.get_type());
+}
+
+/** copies of each kind of ScriptVariable, and what copies share */
+static void testVariables()
+{
+    string longText(100, 's');
+    checkCopies(ScriptVariable());
+    checkCopies(ScriptVariable(4.5L));
+    checkCopies(new ScriptStringValue("short"));
+    checkCopies(new ScriptStringValue(longText));
+    checkCopies(new ScriptNameValue("name"));
+    checkCopies(new ScriptNameValue(longText));
+    checkCopies(new ColorValue("red"));
+
+    /** a long string is shared by its copies, replacing one leaves the rest */
+    ScriptVariable text = new ScriptStringValue(longText), copy = text;
+    CHECK(text.shared && copy.shared && text.long_text == copy.long_text);
+    CHECK(text.long_text->refs == 2);
+    copy = ScriptVariable(string("other"));
+    CHECK(text.long_text->refs == 1);
+    CHECK(get_value<ScriptStringValue>(text) == longText);
+    CHECK(get_value<ScriptStringValue>(copy) == "other");
+
+    /** so is the value of an object, edit_value() copies it first */
+    ScriptVariable color = new ColorValue("red"), shared = color;
+    CHECK(color.value == shared.value);
+    ((ColorValue&)shared.edit_value()).color = "green";
+    CHECK(color.value != shared.value);
+    CHECK(get_value<ColorValue>(color) == "red");
+    CHECK(get_value<ColorValue>(shared) == "green");
+    const ScriptValue* alone = shared.value.get();
+    ((ColorValue&)shared.edit_value()).color = "blue";
+    CHECK(shared.value.get() == alone);
+    CHECK(get_value<ColorValue>(shared) == "blue");
+
+    /** assigning a variable something inside its own value */
+    ListValue* list = new ListValue();
+    list->items.push_back(new ScriptStringValue(longText));
+    list->items.push_back(ScriptVariable(2.0L));
+    ScriptVariable other(list->copy()), owner(list);
+    owner = ((const ListValue&)*owner.value).items[0];
+    CHECK(get_value<ScriptStringValue>(owner) == longText);
+    other = std::move(((ListValue&)other.edit_value()).items[1]);
+    CHECK(get_value<ScriptNumberValue>(other) == 2);
+}
+
+/** type checks between the default types and two of an extension */
+static void testTypeIds()
+{
+    ScriptVariable null, two(2.0L), text = new ScriptStringValue("text"),
+                   name = new ScriptNameValue("name"), red = new ColorValue("red"),
+                   blue = new ColorValue("blue"), list = new ListValue();
+
+    CHECK(script_type_id<ScriptNullValue>() == ScriptVariable::NUL);
+    CHECK(script_type_id<ScriptNumberValue>() == ScriptVariable::NUMBER);
+    CHECK(script_type_id<ScriptStringValue>() == ScriptVariable::STRING);
+    CHECK(script_type_id<ScriptNameValue>() == ScriptVariable::NAME);
+    CHECK(script_type_id<ColorValue>() >= ScriptVariable::OBJECT);
+    CHECK(script_type_id<ColorValue>() != script_type_id<ListValue>());
+    CHECK(script_type_id<ColorValue>() == script_type_id(ColorValue("green")));
+
+    CHECK(is_typeof<ScriptNullValue>(null));
+    CHECK(is_typeof<ScriptNumberValue>(two));
+    CHECK(is_typeof<ScriptStringValue>(text));
+    CHECK(is_typeof<ScriptNameValue>(name));
+    CHECK(is_typeof<ColorValue>(red));
+    CHECK(is_typeof<ListValue>(list));
+    CHECK(!is_typeof<ColorValue>(list));
+    CHECK(!is_typeof<ListValue>(red));
+    CHECK(!is_typeof<ScriptStringValue>(name));
+    for (const ScriptVariable* var : { &null, &two, &text, &name })
+        CHECK(!is_typeof<ColorValue>(*var) && !is_typeof<ListValue>(*var));
+    CHECK((is_same_type<ColorValue, ColorValue>()));
+    CHECK((!is_same_type<ColorValue, ListValue>()));
+
+    CHECK(is_same_type(red, blue));
+    CHECK(!is_same_type(red, list));
+    CHECK(!is_same_type(red, text));
+    CHECK(red.get_type() == "Color" && list.get_type() == "List");
+
+    /** a copy edited through edit_value() is still of the same type */
+    ScriptVariable green = red;
+    ((ColorValue&)green.edit_value()).color = "green";
+    CHECK(is_typeof<ColorValue>(green) && is_same_type(green, red));
+}
+
+int main()
+{
+    testControlFlow();
+    testRecompileWhileRunning();
+    testCacheAfterBake();
+    testMistypedValues();
+    testVariables();
+    testTypeIds();
+
+    if (failures)
+        printf("%d checks failed\n", failures);
+    else
+        printf("all checks passed\n");
+    return failures ? 1 : 0;
+}